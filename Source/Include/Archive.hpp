@@ -0,0 +1,81 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Archive.hpp
+//
+// Header file for the `Archive` class. Rather than one file per trial for
+// each of the positions, separations and outputs, `--archive` appends every
+// one of them as a record to a single file. Each record is exactly the image
+// of a `BinaryFile` (header + contiguous columns). When the run finishes an
+// index of all records is written as a footer so any (kind, trial) can be
+// read back without scanning. An archive without a footer (an interrupted
+// run) is still readable, the index is rebuilt from the record headers.
+//
+//     [ header | record | record | ... | index entries | trailer ]
+//
+
+#ifndef _ARCHIVE_HH_
+#define _ARCHIVE_HH_
+
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <BinaryFile.hpp>
+
+namespace Gaia {
+
+class Archive {
+
+public:
+
+	// an entry in the index footer
+	struct Entry {
+
+		char          kind[8]; // same as the record's header
+		std::uint32_t trial;
+		std::uint32_t dtype;
+		std::uint64_t offset;  // of the record's header from start of file
+		std::uint64_t bytes;   // size of the record (header included)
+	};
+
+	// create a new archive at `filename` for writing, or with `append`
+	// continue an existing one (when resuming a run)
+	Archive(const std::string &filename, const bool append = false);
+	~Archive();
+
+	// drop the records after `trial` (and the pooled ones) from an archive
+	// opened for appending
+	void Discard(const std::size_t trial);
+
+	// append a record (thread safe)
+	void Append(const BinaryFile::Header &header,
+		const std::vector<const double*> &columns);
+
+	// write the index footer and close the file
+	void Close();
+
+	// the index of an existing archive
+	static std::vector<Entry> Index(const std::string &filename);
+
+	// read the record for `kind` and `trial`, columns are returned as float64
+	static BinaryFile::Header Read(const std::string &filename,
+		const std::string &kind, const std::size_t trial,
+		std::vector< std::vector<double> > &columns);
+
+	// true if `filename` starts like an archive
+	static bool IsArchive(const std::string &filename);
+
+private:
+
+	std::string _filename;
+	FILE *_file;
+	std::uint64_t _offset;
+	std::vector<Entry> _index;
+	std::mutex _lock;
+};
+
+} // namespace Gaia
+
+#endif
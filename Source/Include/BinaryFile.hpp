@@ -0,0 +1,85 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/BinaryFile.hpp
+//
+// Header file for the `BinaryFile` class. Positions and separations can be
+// written as raw little-endian arrays (float64 or float32) rather than text.
+// The file is a small self-describing 128 byte header followed by one
+// contiguous array per column, so downstream tools can map it directly, e.g.
+//
+//     numpy.memmap(name, dtype, offset=128, shape=(columns, rows))
+//
+// A density cube for a `Profile` uses the same layout with kind "cube": one
+// column per Z plane, each holding the plane with X varying fastest, and the
+// three lengths in `shape`.
+//
+
+#ifndef _BINARYFILE_HH_
+#define _BINARYFILE_HH_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Gaia {
+
+class BinaryFile {
+
+public:
+
+	// header of a binary output file (padded to 128 bytes)
+	struct Header {
+
+		char          magic[8];  // "GAIABIN"
+		std::uint32_t version;   // format version
+		std::uint32_t dtype;     // bytes per value, 8 (float64) or 4 (float32)
+		std::uint64_t rows;      // length of each column (N)
+		std::uint32_t columns;   // number of arrays that follow
+		std::uint32_t trial;     // trial number (0 for pooled results)
+		std::uint64_t seed;      // `--first-seed` of the run
+		double        limits[6]; // X, Y and Z limits of the `box`
+		char          kind[8];   // "pos", "raw", ...
+		std::uint64_t shape[3];  // X, Y and Z lengths of a "cube" (else 0)
+		char          padding[8];
+	};
+
+	// construct a header for a new file
+	static Header NewHeader(const std::string &kind, const std::size_t rows,
+		const std::size_t columns, const std::size_t trial,
+		const std::size_t dtype = 8);
+
+	// write `columns` (each of length `header.rows`) to `filename`
+	static void Write(const std::string &filename, const Header &header,
+		const std::vector<const double*> &columns);
+
+	// read a file back, columns are returned as float64
+	static Header Read(const std::string &filename,
+		std::vector< std::vector<double> > &columns);
+
+	// the same at the current position of an open `stream` (`name` is used
+	// for error messages), Write() returns the number of bytes written
+	static std::uint64_t Write(FILE *stream, const std::string &name,
+		const Header &header, const std::vector<const double*> &columns);
+	static Header Read(FILE *stream, const std::string &name,
+		std::vector< std::vector<double> > &columns);
+
+	// size of a file or record with this header (in bytes)
+	static std::uint64_t Bytes(const Header &header);
+
+	// export a binary file as (whitespace delimited) text
+	static void Convert(const std::string &input, const std::string &output);
+
+	// true if the host stores numbers little-endian
+	static bool LittleEndian();
+
+	// reverse the byte order of `n` values of `size` bytes in place
+	static void Swap(void *data, const std::size_t size, const std::size_t n);
+
+	// put the numeric fields of a header in the other byte order
+	static void Swap(Header &header);
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/BucketFile.hpp
+//
+// Header file for the `BucketFile` class. When a population does not fit in
+// `--max-memory` it is built in batches that are sorted into the cells of a
+// coarse grid (the buckets) and appended to a scratch file. The nearest
+// neighbor search then visits the samples bucket by bucket and loads the
+// surrounding buckets (the halo) on demand, shell by shell, until no closer
+// neighbor is possible. Loaded buckets are kept in a cache of bounded size.
+
+#ifndef _BUCKETFILE_HH_
+#define _BUCKETFILE_HH_
+
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Vector.hpp>
+#include <PositionArray.hpp>
+
+namespace Gaia {
+
+class BucketFile {
+
+public:
+
+	// a position and its index in the population
+	struct Record {
+
+		double x, y, z;
+		std::uint64_t id;
+	};
+
+	// `filename` is created for scratch space and removed again, the grid
+	// covers the `box` with about `N` / `bucket` records per bucket and at
+	// most `cache` bytes of buckets are held in memory at once
+	BucketFile(const std::string &filename, const std::vector<double> &X,
+		const std::vector<double> &Y, const std::vector<double> &Z,
+		const std::size_t N, const std::size_t cache);
+	~BucketFile();
+
+	// discard the current population (and the cache)
+	void Reset();
+
+	// sort a batch of records into buckets and append it (reorders `batch`)
+	void Append(std::vector<Record> &batch);
+
+	// nearest neighbor distance for each of the `samples` (their ids are
+	// their indices), `best` holds the initial search radius
+	void Nearest(const PositionArray &samples, std::vector<double> &best);
+
+	// number of buckets (cells in the grid)
+	std::size_t Size() const { return _runs.size(); }
+
+	// records per bucket aimed for
+	static std::size_t BucketSize(const std::size_t cache);
+
+private:
+
+	// bucket index for the cell at (a, b, c) and for a position
+	std::size_t Index(const long a, const long b, const long c) const;
+	std::size_t Locate(const double x, const double y, const double z) const;
+
+	// shortest distance from `point` to the box of bucket (a, b, c)
+	double Distance(const Vector &point, const long a, const long b,
+		const long c) const;
+
+	// read a bucket (sorted by x) into the cache, never evicting `keep`
+	const std::vector<Record>& Load(const std::size_t bucket,
+		const std::size_t keep);
+
+	// update `best` for `members` of `samples` with the records of a bucket
+	void Search(const std::vector<Record> &bucket,
+		const PositionArray &samples,
+		const std::vector<std::size_t> &members, std::vector<double> &best);
+
+	std::string _filename;
+	FILE *_file;
+	std::uint64_t _length; // records in the file
+
+	// geometry of the grid
+	double _origin[3], _width[3], _slack;
+	long _cells[3];
+
+	// (offset, count) of each run of records for every bucket
+	std::vector< std::vector< std::pair<std::uint64_t, std::uint64_t> > > _runs;
+	std::vector<std::uint64_t> _count;
+
+	// loaded buckets, their last use and the bytes they hold
+	std::map<std::size_t, std::pair< std::vector<Record>, std::uint64_t > >
+		_cache;
+	std::uint64_t _clock;
+	std::size_t _bytes, _max_bytes;
+};
+
+} // namespace Gaia
+
+#endif
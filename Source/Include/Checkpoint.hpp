@@ -0,0 +1,61 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Checkpoint.hpp
+//
+// Header file for the `Checkpoint` class. With `--checkpoint` the pooled
+// statistics, the number of completed trials and the state of the random
+// number generators are written to a small binary file after every
+// `--checkpoint-every` trials. `--resume` reads it back and the run carries
+// on from the next trial with exactly the same results as if it had never
+// stopped. A signature of the configuration guards against resuming with
+// different parameters.
+
+#ifndef _CHECKPOINT_HH_
+#define _CHECKPOINT_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Gaia {
+
+class Checkpoint {
+
+public:
+
+	// everything needed to continue a run
+	struct State {
+
+		std::uint32_t completed;   // number of finished trials
+		std::uint64_t signature;   // of the configuration
+		std::vector<double> mean, variance;    // pooled (flattened)
+		std::vector<unsigned long long> rng;   // generator state
+		std::vector<double> squares;           // with `--num-trials auto`
+	};
+
+	// header of the file (64 bytes, little-endian)
+	struct Header {
+
+		char          magic[8];  // "GAIACHK"
+		std::uint32_t version;
+		std::uint32_t completed;
+		std::uint64_t signature;
+		std::uint64_t pooled;    // length of `mean` (and `variance`)
+		std::uint64_t rng;       // length of `rng`
+		std::uint64_t squares;   // length of `squares`
+		char          padding[16];
+	};
+
+	// write `state` to `filename` (atomically, by renaming a temporary)
+	static void Save(const std::string &filename, const State &state);
+
+	// read `state` back from `filename`
+	static void Load(const std::string &filename, State &state);
+
+	// 64-bit FNV-1a hash of a string (for the signature)
+	static std::uint64_t Signature(const std::string &configuration);
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,57 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/DefinedProfile.hpp
+//
+// Header file for the `DefinedProfile` class, an analytical profile given by
+// `define Name "expression"` in the rc file (see Expression.hpp) rather than
+// written in `Profiles.hpp`. Its symmetry follows from the coordinates the
+// expression uses, and it evaluates whole blocks of candidates at once.
+
+#ifndef _DEFINEDPROFILE_HH_
+#define _DEFINEDPROFILE_HH_
+
+#include <cstddef>
+#include <string>
+
+#include <ProfileBase.hpp>
+#include <Expression.hpp>
+#include <Point.hpp>
+
+namespace Gaia {
+
+class DefinedProfile: public ProfileBase {
+
+public:
+
+	DefinedProfile(const std::string &name, const std::string &text):
+		ProfileBase(name), _expression(name, text){
+
+		if ( !_expression.Axisymmetric() ) symmetry = NONE;
+		else if ( _expression.Spherical() && !_expression.Planar() )
+			symmetry = SPHERICAL;
+		else if ( _expression.Planar() && !_expression.Spherical() )
+			symmetry = PLANAR;
+		else symmetry = AXISYMMETRIC;
+	}
+
+	virtual double Function(const Point &point){
+		return _expression.Evaluate(point);
+	}
+
+	virtual void Batch(const double *x, const double *y, const double *z,
+		const std::size_t n, double *out){
+		_expression.Evaluate(x, y, z, n, out);
+	}
+
+	virtual bool Batched() const { return true; }
+
+	const Expression& GetExpression() const { return _expression; }
+
+private:
+
+	Expression _expression;
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Envelope.hpp
+//
+// Header file for the `Envelope` class. When every profile in use depends
+// only on R and Z (it is axisymmetric, spherical or planar) the product of
+// the profiles, each clipped to [0, 1] as the rejection test uses them, is
+// tabulated once on a grid in (R, Z) that covers the `box`. The largest
+// value in each cell (with a margin) times the area of its ring gives a
+// piecewise constant envelope whose cumulative distribution is sampled
+// directly: a cell, then R (with the Jacobian) and Z within it, and Phi
+// uniformly. A candidate is kept with probability product / envelope,
+// so neither the corners of the `box` outside the disk nor the radii where
+// the density is low cost many proposals.
+//
+// The bounds are only found at a few points in each cell, so this is for
+// profiles that vary smoothly over a cell (with `--envelope`). A product
+// found above its bound raises the bound of the cell, and the population
+// is drawn again; a feature narrower than a cell that no candidate lands
+// on goes unnoticed.
+
+#ifndef _ENVELOPE_HH_
+#define _ENVELOPE_HH_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <ProfileBase.hpp>
+#include <ProfileChain.hpp>
+#include <Random.hpp>
+#include <Vector.hpp>
+
+// cells of the table in R and Z
+#define ENVELOPE_R 256
+#define ENVELOPE_Z 128
+
+namespace Gaia {
+
+class Envelope {
+
+public:
+
+	// tabulate the product of `profiles` for the `box` (from the compiled
+	// `chain` over them if there is one)
+	Envelope(const std::vector<ProfileBase*> &profiles,
+		const std::vector<double> &X, const std::vector<double> &Y,
+		const std::vector<double> &Z, const ChainBase *chain = nullptr);
+
+	// draw a candidate with generator `thread` of `source`, its `cell` and
+	// the value of the envelope there (keep it with probability product /
+	// `bound`)
+	Vector Sample(ParallelMT *source, const int thread, double &bound,
+		std::size_t &cell) const;
+
+	// the product of the profiles
+	double Evaluate(const Vector &position) const;
+
+	// the envelope fell short of the `product` in `cell`
+	void Exceeded(const std::size_t cell, const double product);
+
+	// raise the bounds that fell short since the last call, and give the
+	// number of candidates that found them short (0 if none did); no other
+	// thread may be sampling meanwhile
+	std::size_t Raise();
+
+	// expected fraction of candidates kept (before clipping to the `box`)
+	double Efficiency() const { return _efficiency; }
+
+private:
+
+	std::vector<ProfileBase*> _profiles;
+	const ChainBase *_chain;
+
+	// edges of the cells
+	std::vector<double> _R, _Z;
+
+	// envelope in each cell and its cumulative weight (R major), and the
+	// largest product found above it
+	std::vector<double> _bound, _cumulative, _short;
+
+	// cumulative weights and efficiency from the bounds
+	void Accumulate();
+
+	double _mass, _efficiency;
+	std::size_t _exceeded;
+	std::mutex _lock;
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Expression.hpp
+//
+// Header file for the `Expression` class. An analytical profile can be
+// given in the rc file instead of `Profiles.hpp`,
+//
+//     define MyDisk "0.2 * exp(-abs(Z) / 0.3 - R / 2.6)"
+//     include MyDisk
+//
+// The text is compiled once into a short register program: constants are
+// folded, identical subexpressions (every coordinate in particular) are
+// computed once, and `x^2` becomes a product. A program runs either on one
+// `Point` or, one instruction at a time, over blocks of positions given as
+// separate X, Y and Z arrays, where each instruction is a plain loop the
+// compiler can vectorize and the cost of interpreting it is shared by the
+// whole block.
+//
+// The coordinates are X, Y, Z, R, Rho, Phi and Theta (as in `Vector`), the
+// constants `pi` and `e`, the operators + - * / ^ and the functions exp,
+// log, log10, sqrt, abs, sin, cos, tan, asin, acos, atan, sinh, cosh, tanh,
+// floor, ceil, atan2, pow, min and max.
+
+#ifndef _EXPRESSION_HH_
+#define _EXPRESSION_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <Point.hpp>
+
+// the most registers (distinct subexpressions) a program may use, and the
+// positions evaluated together by the batched form
+#define EXPRESSION_REGISTERS 256
+#define EXPRESSION_BLOCK     256
+
+namespace Gaia {
+
+class Expression {
+
+public:
+
+	// compile `text` (the definition of `name`), throws a ProfileError that
+	// points at the problem if it isn't a valid expression
+	Expression(const std::string &name, const std::string &text);
+
+	// the value at one position
+	double Evaluate(const Point &point) const;
+
+	// the values at `n` positions given by their coordinates
+	void Evaluate(const double *x, const double *y, const double *z,
+		const std::size_t n, double *out) const;
+
+	// the program depends on X, Y or Phi (is not axisymmetric), only on
+	// Rho, or only on Z
+	bool Axisymmetric() const;
+	bool Spherical() const;
+	bool Planar() const;
+
+	// instructions and registers of the compiled program
+	std::size_t Instructions() const { return _code.size(); }
+	std::size_t Registers() const { return _registers; }
+
+	enum Operation { CONSTANT, X, Y, Z, R, RHO, PHI, THETA, ADD, SUBTRACT,
+		MULTIPLY, DIVIDE, POWER, NEGATE, SQUARE, EXP, LOG, LOG10, SQRT, ABS,
+		SIN, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH, FLOOR, CEIL,
+		ATAN2, MIN, MAX };
+
+private:
+
+	// a node of the expression, operands are indices of other nodes
+	struct Node {
+		Operation op;
+		std::size_t a, b;
+		double value;
+	};
+
+	// an instruction of the program, operands are registers
+	struct Instruction {
+		Operation op;
+		std::uint16_t target, a, b;
+	};
+
+	// recursive descent, each returns the index of a node
+	std::size_t Sum();
+	std::size_t Product();
+	std::size_t Unary();
+	std::size_t Power();
+	std::size_t Primary();
+
+	// a node for `op`, folded to a constant or shared with an identical one
+	std::size_t Make(const Operation op, const std::size_t a = 0,
+		const std::size_t b = 0);
+	std::size_t Constant(const double value);
+
+	// the lexer
+	void Skip();
+	bool Accept(const char c);
+	void Expect(const char c);
+	void Fail(const std::string &what) const;
+
+	// turn the nodes the result depends on into the program
+	void Emit(const std::size_t root);
+
+	// the operation on scalars (loads excluded)
+	static double Apply(const Operation op, const double a, const double b);
+
+	std::string _name, _text;
+	std::size_t _position;
+
+	std::vector<Node> _nodes;
+	std::map< std::tuple<int, std::size_t, std::size_t>, std::size_t > _shared;
+	std::map<double, std::size_t> _constants;
+
+	// the constants fill the first registers
+	std::vector<double> _pool;
+	std::vector<Instruction> _code;
+	std::size_t _registers, _result;
+	bool _uses[THETA + 1];
+};
+
+} // namespace Gaia
+
+#endif
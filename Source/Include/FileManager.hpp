@@ -2,7 +2,11 @@
 // GNU General Public License v3.0
 // Include/FileManager.hpp
 //
-// TODO: header
+// Header file for the `FileManager` singleton. All output files are written
+// here. With `--async-io` the data for each file is copied into a bounded
+// queue and written by a dedicated thread while the next trial is computed.
+// With `--archive` every trial's records are appended to a single `Archive`.
+// With `--format=fits` tables and images are written as FITS files.
 
 #ifndef _FILEMANAGER_HH_
 #define _FILEMANAGER_HH_
@@ -10,8 +14,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
 
 #include <Vector.hpp>
+#include <PositionArray.hpp>
+#include <Archive.hpp>
 
 namespace Gaia {
 
@@ -21,11 +33,11 @@ public:
 
     static FileManager* GetInstance();
     static void Release();
-    ~FileManager(){}
+    ~FileManager();
 
     void Initialize();
 
-    void SavePositions(const std::vector<Vector>&, const std::size_t );
+    void SavePositions(const PositionArray&, const std::size_t );
 
     void SaveRaw( const std::vector<double>&, const std::size_t );
 
@@ -37,13 +49,69 @@ public:
     void SaveOutput( const std::vector< std::vector<double> >&,
         const std::vector< std::vector<double> >&, const std::size_t );
 
+    // block until all queued writes are finished, raises any write error
+    void Drain();
+
+    // drain and write the archive's index (if any)
+    void Close();
+
+    // continue after `trial` completed trials of an earlier run
+    void Resume(const std::size_t trial);
+
 private:
 
     static FileManager* instance;
-    FileManager(){}
+    FileManager(): archive(nullptr), async(false), busy(false),
+        stopping(false){}
 
     int verbose;
-    std::string pos_path, raw_path, out_path, map_path;
+    std::string pos_path, raw_path, out_path, map_path, format, arc_path;
+
+    // binary output of positions and separations (bytes per value)
+    bool binary;
+    std::size_t dtype;
+
+    // FITS output, images need the analysis axes for their WCS
+    bool fits;
+    std::vector<std::string> axes;
+    std::map<std::string, std::vector<double>> linespaces;
+
+    // all records go to one file with `--archive`
+    Archive *archive;
+
+    // the actual writing (on the writer thread with `--async-io`)
+    void WritePositions(const std::string&, const PositionArray&,
+        const std::size_t);
+    void WriteRaw(const std::string&, const std::vector<double>&,
+        const std::size_t);
+    void WriteMatrix(const std::string&,
+        const std::vector< std::vector<double> >&, const std::string&,
+        const std::size_t);
+    void WriteOutput(const std::string&, const std::vector<double>&,
+        const std::vector<double>&, const std::size_t);
+    void WriteImages(const std::string&,
+        const std::vector< std::vector<double> >&,
+        const std::vector< std::vector<double> >&, const std::size_t);
+
+    // a queued write and the memory it holds
+    struct Job {
+        std::function<void()> task;
+        std::size_t bytes;
+    };
+
+    // hand a task to the writer thread (waits while the queue is full)
+    void Dispatch(std::function<void()>, const std::size_t);
+
+    // body of the writer thread
+    void Writer();
+
+    bool async, busy, stopping;
+    std::size_t queued_bytes, max_bytes;
+    std::deque<Job> queue;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable ready, space;
+    std::exception_ptr error;
 
 };
 
@@ -0,0 +1,77 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Fits.hpp
+//
+// Header file for the `Fits` class. With `--format=fits` positions and
+// separations are written as FITS binary tables and the 2D analysis maps as
+// IMAGE HDUs whose WCS keywords come from the `Axis` linespaces, so they can
+// be opened directly in ds9 (e.g. next to `Examples/NGC1300/Raw`). Each HDU
+// is a set of 2880 byte blocks; data is converted to big-endian and written
+// through a buffer that is a whole number of blocks.
+//
+// ReadCube() goes the other way for the density cubes of a `Profile`: the
+// first image HDU with three axes (e.g. from a simulation or an IFU).
+
+#ifndef _FITS_HH_
+#define _FITS_HH_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Gaia {
+
+class Fits {
+
+public:
+
+	// create a new FITS file at `filename`
+	Fits(const std::string &filename);
+	~Fits();
+
+	// append a BINTABLE with one float64 column of length `rows` per name
+	// (an empty primary HDU is written first if needed)
+	void Table(const std::string &extname,
+		const std::vector<std::string> &names,
+		const std::vector<const double*> &columns, const std::size_t rows,
+		const std::size_t trial);
+
+	// append a float64 image, `data[i][j]` is the pixel at `axes[0][i]` and
+	// `axes[1][j]`; the first image becomes the primary HDU
+	void Image(const std::string &extname,
+		const std::vector< std::vector<double> > &data,
+		const std::vector<std::string> &names,
+		const std::vector< std::vector<double> > &axes,
+		const std::size_t trial);
+
+	// flush and close the file
+	void Close();
+
+	// read the first image with three axes in `filename` as float64 (scaled
+	// by BSCALE and BZERO, blank or non-finite pixels become 0), `shape`
+	// gets NAXIS1, NAXIS2 and NAXIS3 and NAXIS1 varies fastest in `data`
+	static void ReadCube(const std::string &filename, std::size_t shape[3],
+		std::vector<double> &data);
+
+private:
+
+	// write the header cards (and the END card) padded to a block
+	void Write(std::string &cards);
+
+	// write `count` float64 values (big-endian), value `k` from `get(k)`,
+	// padded to a block
+	template<class Accessor>
+	void Data(const std::size_t count, Accessor get);
+
+	// keywords shared by every HDU (trial, seed, limits)
+	void Common(std::string &cards, const std::string &extname,
+		const std::size_t trial);
+
+	std::string _filename;
+	FILE *_file;
+	bool _primary;
+};
+
+} // namespace Gaia
+
+#endif
@@ -3,7 +3,9 @@
 // Include/Interpolation.hpp
 //
 // General interpolation objects. Interp1D and Interp2D provide
-// Linear and Bilinear Interpolation respectively.
+// Linear and Bilinear Interpolation respectively, TriLinear interpolates a
+// cube on a uniform grid. BiCubic is a smooth (Catmull-Rom) alternative to
+// BiLinear on a uniform grid.
 //
 // These object throw an InterpError exception derived from the
 // std::exception
@@ -11,6 +13,7 @@
 #ifndef _INTERPOLATE_HH_
 #define _INTERPOLATE_HH_
 
+#include <cstddef>
 #include <exception>
 #include <string>
 #include <vector>
@@ -32,11 +35,22 @@ public:
     // find a new `y` given a new `x`
     T Interpolate(const T &x);
 
+    // find new `y` values at `n` positions in any order (`out` may be `x`,
+    // positions outside extend the first or last interval); if `x` is not
+    // evenly spaced the positions are sorted with `order` (room for `n`
+    // indices) and merged with it, or searched for one by one without it
+    void Interpolate(const T *x, const std::size_t n, T *out,
+        std::size_t *order = nullptr) const;
+
 private:
 
     // keep local data
     std::vector<T> x, y, m;
 
+    // evenly spaced `x` (first value and inverse spacing)
+    bool uniform;
+    T origin, inverse;
+
 };
 
 template<class T>
@@ -54,11 +68,20 @@ public:
     // find a new `z` given a new `x`, `y` pair
     T Interpolate(const T &x, const T &y);
 
+    // find new `z` values at `n` pairs in any order, as with Linear (but
+    // `out` may not be `x` or `y` here)
+    void Interpolate(const T *x, const T *y, const std::size_t n, T *out,
+        std::size_t *order = nullptr) const;
+
 private:
 
     // set of two vectors represent rectilinear grid
     std::vector<T> x, y;
 
+    // evenly spaced `x` and `y` (first value and inverse spacing)
+    bool uniform[2];
+    T origin[2], inverse[2];
+
     // matrix of values for x, y pairs
     std::vector< std::vector<T> > z;
 
@@ -67,6 +90,69 @@ private:
 
 };
 
+template<class T>
+class BiCubic {
+
+public:
+
+    // as BiLinear, but `x` and `y` must be evenly spaced; the coefficients
+    // of the cubic patch over every cell are found here
+    BiCubic(const std::vector<T>& x, const std::vector<T> &y,
+        const std::vector< std::vector<T> > &z);
+
+    // find a new `z` given a new `x`, `y` pair (positions outside are taken
+    // from the nearest edge)
+    T Interpolate(const T &x, const T &y) const;
+
+    // the same at `n` positions given by their coordinates
+    void Interpolate(const T *x, const T *y, const std::size_t n, T *out) const;
+
+private:
+
+    // first value and inverse spacing of each axis, and its length
+    T origin[2], inverse[2];
+    std::size_t size[2];
+
+    // 16 coefficients per cell (rows of cells along `y`), the one of u^p v^q
+    // at 4 p + q where `u` and `v` run from 0 to 1 across the cell
+    std::vector<T> coefficients;
+
+    std::size_t Cell(const int axis, const T &value, T &fraction) const;
+
+};
+
+template<class T>
+class TriLinear {
+
+public:
+
+    // `x`, `y` and `z` are evenly spaced and ascending, `data` holds the
+    // values with `x` varying fastest, data[(k * ny + j) * nx + i]
+    TriLinear(const std::vector<T> &x, const std::vector<T> &y,
+        const std::vector<T> &z, const std::vector<T> &data);
+
+    // find a new value given a new `x`, `y`, `z` (the cell is found
+    // arithmetically, positions outside are taken from the nearest face)
+    T Interpolate(const T &x, const T &y, const T &z) const;
+
+    // the same at `n` positions given by their coordinates
+    void Interpolate(const T *x, const T *y, const T *z, const std::size_t n,
+        T *out) const;
+
+private:
+
+    // first value and inverse spacing of each axis, and its length
+    T origin[3], inverse[3];
+    std::size_t size[3];
+
+    // the cube, stored flat
+    std::vector<T> data;
+
+    // the index of the cell along `axis` and the fraction within it
+    std::size_t Cell(const int axis, const T &value, T &fraction) const;
+
+};
+
 // base exception class for Interpolator objects
 class InterpException : public std::exception {
 
@@ -46,11 +46,40 @@ public:
 	std::string GetPosPath() const;
 	std::string GetMapPath() const;
 	std::string GetRCFile() const;
+	std::string GetCachePath() const;
+	bool GetCacheFlag() const;
+	std::string GetFormat() const;
+	bool GetAsyncFlag() const;
+	std::size_t GetIOBuffer() const;
+	bool GetArchiveFlag() const;
+	std::string GetArchivePath() const;
+	std::size_t GetMaxMemory() const;
+	std::string GetScratchPath() const;
+	bool GetPipelineFlag() const;
+	int GetBuildThreads() const;
+	std::string GetParallelMode() const;
+	bool GetCheckpointFlag() const;
+	std::string GetCheckpointPath() const;
+	int GetCheckpointEvery() const;
+	bool GetResumeFlag() const;
+	bool GetAutoTrialsFlag() const;
+	double GetTolerance() const;
+	std::string GetProposals() const;
+	bool GetRestartFlag() const;
+	bool GetSamplerFlag() const;
+	bool GetEnvelopeFlag() const;
+	bool GetReorderFlag() const;
+	std::string GetInterpolation() const;
+	bool GetVoxelFlag() const;
+	std::string GetVoxelPath() const;
+	std::size_t GetVoxelResolution() const;
+	double GetVoxelTolerance() const;
 	unsigned long long GetFirstSeed() const;
 	double GetSampleRate() const;
 	double GetMeanBandwidth() const;
 	double GetStdevBandwidth() const;
 	std::map<std::string, std::string> GetUsedPDFs() const;
+	std::map<std::string, std::string> GetDefinedPDFs() const;
 
 private:
 
@@ -81,18 +110,25 @@ private:
 	// helper functions for `Command` map
 	void Set(const std::vector<std::string>&);
 	void Include(const std::vector<std::string>&);
+	void Define(const std::vector<std::string>&);
 
 	// maps of parameters
 	std::map<std::string, std::string> argument, implicit;
 	std::map<std::string, bool> given;
 
 	// simulation parameters, see SetDefaults() for defaults
-	int _verbose, _num_threads, _num_trials, _line_number;
-	bool _keep_raw, _keep_pos, _no_analysis, _debug_mode;
-	std::size_t _num_particles;
+	int _verbose, _num_threads, _num_trials, _line_number, _build_threads;
+	int _checkpoint_every;
+	bool _keep_raw, _keep_pos, _no_analysis, _debug_mode, _use_cache, _async_io;
+	bool _archive, _pipeline, _checkpoint, _resume, _auto_trials, _restart;
+	bool _sampler, _envelope, _voxel_cache, _reorder;
+	std::size_t _num_particles, _io_buffer, _max_memory, _voxel_resolution;
 	std::string _out_path, _raw_path, _pos_path, _map_path, _rc_file;
+	std::string _cache_path, _format, _archive_path, _scratch_path, _parallel;
+	std::string _checkpoint_path, _proposals, _voxel_path, _interpolation;
 	unsigned long long _first_seed;
-	double _sample_rate, _mean_bandwidth, _stdev_bandwidth;
+	double _sample_rate, _mean_bandwidth, _stdev_bandwidth, _tolerance;
+	double _voxel_tolerance;
 
 	// vector for `argv`
 	std::vector<std::string> _cmd_args;
@@ -106,6 +142,9 @@ private:
 
 	// map of profile names from RC-file with file paths
 	std::map<std::string, std::string> UsedPDFs;
+
+	// profiles `define`d in the RC-file and their expressions
+	std::map<std::string, std::string> DefinedPDFs;
 };
 
 } // namespace Gaia
@@ -0,0 +1,78 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Plugin.hpp
+//
+// The interface for profile plugins. A plugin is a shared library, built on
+// its own against this header only, that is used from the rc file with
+//
+//     include plugin:libmydisk.so
+//     include plugin:/path/to/libmydisk.so "argument for the plugin"
+//
+// It exports `gaia_register` with C linkage, which fills in a `GaiaPlugin`
+// for the `box` (`limits` holds Xmin, Xmax, Ymin, Ymax, Zmin, Zmax) and
+// returns 0, or returns anything else to refuse (`message` may say why).
+// Only `version` and `evaluate` are required, the other hooks may be left
+// null:
+//
+//     batch    - the densities at `n` positions given as separate arrays
+//                (used by `Build` on blocks of candidates, see
+//                ProfileBase::Batch)
+//     bound    - an upper bound of the density in the `box`, the densities
+//                are divided by it so that candidates are kept as often as
+//                possible (and values above 1 are not clipped)
+//     sample   - a position drawn from the density (or from a region that
+//                covers the `box`) using `uniform(source)` for random numbers
+//                in [0, 1), as ProfileBase::Sample
+//     release  - called with `state` when the profile is destroyed
+//
+// This header is plain C so that plugins may be written in C as well.
+
+#ifndef _PLUGIN_HH_
+#define _PLUGIN_HH_
+
+#include <stddef.h>
+
+#define GAIA_PLUGIN_VERSION 1
+
+// values of `symmetry` (as ProfileBase::Symmetry)
+#define GAIA_SYMMETRY_NONE         0
+#define GAIA_SYMMETRY_AXISYMMETRIC 1
+#define GAIA_SYMMETRY_SPHERICAL    2
+#define GAIA_SYMMETRY_PLANAR       3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GaiaPlugin {
+
+	unsigned version;  // GAIA_PLUGIN_VERSION
+	const char *name;  // shown to the user (the file name if null)
+	int symmetry;      // GAIA_SYMMETRY_*
+	void *state;       // handed back to every hook
+
+	double (*evaluate)(void *state, double x, double y, double z);
+
+	void (*batch)(void *state, const double *x, const double *y,
+		const double *z, size_t n, double *out);
+
+	double (*bound)(void *state);
+
+	void (*sample)(void *state, double (*uniform)(void *source),
+		void *source, double *position);
+
+	void (*release)(void *state);
+
+} GaiaPlugin;
+
+typedef int (*GaiaRegister)(GaiaPlugin *plugin, const double *limits,
+	const char *argument, const char **message);
+
+int gaia_register(GaiaPlugin *plugin, const double *limits,
+	const char *argument, const char **message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
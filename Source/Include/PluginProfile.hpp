@@ -0,0 +1,55 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/PluginProfile.hpp
+//
+// Header file for the `PluginProfile` class, an analytical profile loaded
+// from a shared library at runtime (`include plugin:libmydisk.so`, see
+// Plugin.hpp for what the library provides).
+
+#ifndef _PLUGINPROFILE_HH_
+#define _PLUGINPROFILE_HH_
+
+#include <cstddef>
+#include <string>
+
+#include <ProfileBase.hpp>
+#include <Plugin.hpp>
+#include <Point.hpp>
+#include <Random.hpp>
+
+namespace Gaia {
+
+class PluginProfile: public ProfileBase {
+
+public:
+
+	// load `library` and register the plugin with `argument` (throws a
+	// ProfileError if it can't be loaded or refuses)
+	PluginProfile(const std::string &name, const std::string &library,
+		const std::string &argument);
+	~PluginProfile();
+
+	virtual double Function(const Point &point);
+
+	virtual void Batch(const double *x, const double *y, const double *z,
+		const std::size_t n, double *out);
+	virtual bool Batched() const { return _plugin.batch != nullptr; }
+
+	virtual bool PrepareSampler(){ return _plugin.sample != nullptr; }
+	virtual Vector Sample(ParallelMT *source, const int thread);
+
+	// what the plugin calls itself, and the bound it divides by
+	std::string Description() const { return _description; }
+	double Scale() const { return 1.0 / _inverse; }
+
+private:
+
+	void *_handle;
+	GaiaPlugin _plugin;
+	std::string _description;
+	double _inverse;
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/Point.hpp
+//
+// This is the header file for the `Point` class. A `Point` is a `Vector`
+// that remembers its derived coordinates: `R`, `Rho`, `Phi` and `Theta` are
+// each computed the first time they are asked for and then kept, so the
+// profiles tested against one candidate share a single sqrt, atan2 and acos
+// between them. The profiles are handed a `Point` rather than a `Vector`.
+// The entire class is defined in the header for efficiency.
+
+#ifndef _POINT_HH_
+#define _POINT_HH_
+
+#include <cmath>
+
+#include <Vector.hpp>
+#include <Exception.hpp>
+
+namespace Gaia {
+
+class Point: public Vector {
+
+public:
+
+	Point(const Vector &vec = Vector()): Vector(vec), _known(0){ }
+
+	Point(double x, double y, double z): Vector(x, y, z), _known(0){ }
+
+	// the same values as from `Vector`, computed at most once
+	double R() const {
+		if ( !(_known & KNOWN_R) ){
+			_R = Vector::R();
+			_known |= KNOWN_R;
+		}
+		return _R;
+	}
+
+	double Rho() const {
+		if ( !(_known & KNOWN_RHO) ){
+			_Rho = Vector::Rho();
+			_known |= KNOWN_RHO;
+		}
+		return _Rho;
+	}
+
+	double Phi() const {
+		if ( !(_known & KNOWN_PHI) ){
+			_Phi = Vector::Phi();
+			_known |= KNOWN_PHI;
+		}
+		return _Phi;
+	}
+
+	double Theta() const {
+		if ( !(_known & KNOWN_THETA) ){
+
+			if ( _x == 0.0 && _y == 0.0 && _z == 0.0 )
+				throw DivError("Radius was zero in Point::Theta()!");
+
+			_Theta = acos(_z / Rho());
+			_known |= KNOWN_THETA;
+		}
+		return _Theta;
+	}
+
+	double Mag() const { return Rho(); }
+
+	// `setters` forget the derived coordinates
+	void SetX(const double& x){ _x = x; _known = 0; }
+	void SetY(const double& y){ _y = y; _known = 0; }
+	void SetZ(const double& z){ _z = z; _known = 0; }
+	void SetXYZ(const double& x, const double&y, const double& z){
+		_x = x; _y = y; _z = z; _known = 0;
+	}
+
+private:
+
+	enum { KNOWN_R = 1, KNOWN_RHO = 2, KNOWN_PHI = 4, KNOWN_THETA = 8 };
+
+	mutable double _R, _Rho, _Phi, _Theta;
+	mutable unsigned char _known;
+};
+
+} // namespace Gaia
+
+#endif
@@ -8,12 +8,20 @@
 #define _POPULATIONMANAGER_HH_
 
 #include <vector>
+#include <thread>
+#include <exception>
+#include <cstdint>
 
 #include <FileManager.hpp>
 #include <ProfileManager.hpp>
 #include <Monitor.hpp>
 #include <Random.hpp>
 #include <Vector.hpp>
+#include <Point.hpp>
+#include <PositionArray.hpp>
+#include <BucketFile.hpp>
+#include <Envelope.hpp>
+#include <VoxelCache.hpp>
 
 namespace Gaia {
 
@@ -27,10 +35,19 @@ public:
 	std::size_t start, end;
 
 	// factory function returns vector of intervals
-	static std::vector<Interval> Build(const std::vector<Vector> &input,
+	static std::vector<Interval> Build(const std::size_t length,
 		const std::size_t num);
 };
 
+// everything a worker needs to run a trial on its own
+struct TrialState {
+
+	PositionArray positions;
+	std::vector<double> seperations, mean_1D, variance_1D;
+	std::vector< std::vector<double> > mean_2D, variance_2D;
+	std::exception_ptr error;
+};
+
 class PopulationManager {
 
 public:
@@ -44,6 +61,32 @@ public:
 	// build a new population set
 	void Build(const int trial);
 
+	// build population `trial` in the background while the current one is
+	// analyzed, then wait for it and make it current (pipelined trials)
+	void BuildAhead(const int trial, const int build_threads);
+	void Advance(const int trial);
+
+	// the next population can't be built ahead when streaming
+	bool CanPipeline() const { return !streaming; }
+
+	// the compiled chain of the profiles in use (nullptr if none)
+	const ChainBase* GetChain() const { return profiles -> Chain; }
+
+	// run all trials concurrently (one per thread) instead of one by one
+	bool TrialParallel() const { return trial_parallel; }
+	void RunTrials(const int start);
+
+	// with `--resume` restore the last checkpoint and return the number of
+	// trials it had completed (0 otherwise)
+	int Resume();
+
+	// with `--checkpoint` save the state after `finished` trials (given by
+	// the caller, `completed` only counts the analyzed ones)
+	void SaveProgress(const int finished);
+
+	// with `--num-trials auto`, the pooled statistics are precise enough
+	bool Converged() const { return converged; }
+
 	// solve for the nearest neighbor separations
 	void FindNeighbors(const int trial);
 
@@ -64,12 +107,105 @@ private:
 	// parallel mt19937 PRNG array
 	ParallelMT *generator;
 
+	// quasi-random positions (`--proposals`), rescrambled every trial with
+	// `--qmc-restart`; the acceptance test still uses `generator`
+	QuasiRandom *proposals;
+	QuasiRandom::Sequence sequence;
+	bool qmc_restart;
+
+	// with `--envelope` and only axisymmetric profiles positions come from a
+	// table in (R, Z)
+	Envelope *envelope;
+
+	// with `--voxel-cache` positions are tested against the product of the
+	// profiles on a grid instead
+	VoxelCache *voxels;
+
+	// state of `generator` and `proposals` together (for checkpoints)
+	std::vector<unsigned long long> GetStreams() const;
+	void SetStreams(const std::vector<unsigned long long> &state);
+
     // Monitor
     Monitor *display;
 
     // parser
     Parser *parser;
 
+    // draw positions with generator `thread` of `source` (proposed by
+    // `quasi` if given) until one is accepted
+    Vector Draw(ParallelMT *source, QuasiRandom *quasi, const int thread);
+    bool Propose(ParallelMT *source, QuasiRandom *quasi, const int thread,
+        Vector &candidate);
+
+    // `count` of them into `out` from position `first`, by blocks of
+    // candidates if `batched`; the candidates accepted beyond `count` are
+    // kept in `rest` for the next call (dropped without it)
+    bool batched;
+    void DrawMany(ParallelMT *source, QuasiRandom *quasi, const int thread,
+        PositionArray &out, const std::size_t first, const std::size_t count,
+        PositionArray *rest = nullptr);
+
+    // accepted candidates carried between the calls of each thread, so a
+    // population doesn't depend on how it is split
+    std::vector<PositionArray> leftover;
+
+    // draw a whole population (in memory), or into the scratch file
+    void Populate(PositionArray&, const bool);
+    void Stream();
+
+    // raise the bounds of the (R, Z) table where the profiles exceeded them
+    // (true if the population has to be drawn again)
+    bool Redraw();
+
+    // nearest neighbor distances of the first samples of a population
+    void Separations(const PositionArray&, std::vector<double>&, const bool);
+
+    // a whole trial on the calling thread (trial-level parallelism)
+    bool trial_parallel;
+    void RunTrial(const int trial, TrialState &state);
+
+    // the population built ahead and the thread building it
+    PositionArray spare;
+    std::thread builder;
+    std::exception_ptr ahead_error;
+
+    // generator state when the background build started (the state after
+    // the last completed trial while the next one is being drawn)
+    std::vector<unsigned long long> rng_mark;
+    bool marked;
+
+    // `--checkpoint`, `--checkpoint-every` and `--checkpoint-path`
+    bool checkpoint;
+    int checkpoint_every;
+    std::string checkpoint_path;
+
+    // signature of everything the results depend on (but the trials)
+    std::uint64_t Signature() const;
+
+    // with `--num-trials auto` the sums and sums of squares of the mean and
+    // variance of each trial (flattened, means first) give the standard
+    // error of the pooled statistics, trials stop below `tolerance`
+    bool auto_trials, converged;
+    int completed;
+    double tolerance;
+    std::vector<double> sums, squares;
+    std::string convergence_path;
+
+    // count trial `trial` (in order) and update the convergence
+    void Track(const int trial, const std::vector<double> &mean,
+        const std::vector<double> &variance);
+    void Track(const int trial, const std::vector< std::vector<double> > &mean,
+        const std::vector< std::vector<double> > &variance);
+
+    // largest standard error on the grid relative to the largest value
+    double Metric() const;
+
+    // with `--max-memory` a population that doesn't fit is built into
+    // buckets in a scratch file, only the sampled positions stay in memory
+    bool streaming;
+    BucketFile *buckets;
+    std::size_t batch;
+
     // helper function for building the `Axis` map
     std::vector<double> Linespace(const double, const double, const std::size_t);
 
@@ -81,20 +217,8 @@ private:
     std::vector<std::string> axis;
     std::vector<std::size_t> resolution;
 
-    // map of functions, (just like in ProfileBase)
-    std::map< std::string, double (*)(const Vector&) > Coord;
-
-    // functions in the above map (calls to vector coordinates)
-    static double X(const Vector &vec)     { return vec.X();     }
-    static double Y(const Vector &vec)     { return vec.Y();     }
-    static double Z(const Vector &vec)     { return vec.Z();     }
-    static double R(const Vector &vec)     { return vec.R();     }
-    static double Rho(const Vector &vec)   { return vec.Rho();   }
-    static double Phi(const Vector &vec)   { return vec.Phi();   }
-    static double Theta(const Vector &vec) { return vec.Theta(); }
-
-	// vector of `Vector` positions
-	std::vector<Vector>   positions;
+	// the positions (as arrays of X, Y and Z)
+	PositionArray         positions;
 	std::vector<Interval> interval;
 
 	// nearest neighbor seperations and match to specified coordinates
@@ -0,0 +1,182 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/PositionArray.hpp
+//
+// This is the header file for the `PositionArray` class. A population is
+// kept as three separate arrays of X, Y and Z (a structure of arrays)
+// rather than one array of `Vector`s, so that the loops over a population
+// (nearest neighbors, coordinates for the fit, writing the columns of a
+// binary file) read contiguous memory and vectorize. Each array starts on
+// a cache line. `operator[]` still gives a `Vector` for code that wants
+// one, and the container otherwise stands in for a `std::vector<Vector>`.
+// The entire class is defined in the header for efficiency.
+
+#ifndef _POSITIONARRAY_HH_
+#define _POSITIONARRAY_HH_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <Vector.hpp>
+#include <Exception.hpp>
+
+// the arrays are aligned to this many bytes
+#define POSITION_ALIGNMENT 64
+
+namespace Gaia {
+
+// allocator of memory aligned to POSITION_ALIGNMENT bytes
+template<class T>
+struct AlignedAllocator {
+
+	typedef T value_type;
+
+	AlignedAllocator(){ }
+	template<class U> AlignedAllocator(const AlignedAllocator<U>&){ }
+
+	T* allocate(const std::size_t n){
+
+		void *memory = nullptr;
+
+		if ( posix_memalign(&memory, POSITION_ALIGNMENT, n * sizeof(T)) )
+			throw std::bad_alloc();
+
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T *memory, const std::size_t){ std::free(memory); }
+
+	template<class U> bool operator==(const AlignedAllocator<U>&) const {
+		return true; }
+	template<class U> bool operator!=(const AlignedAllocator<U>&) const {
+		return false; }
+};
+
+class PositionArray {
+
+public:
+
+	typedef std::vector< double, AlignedAllocator<double> > Stream;
+
+	PositionArray(const std::size_t n = 0): _x(n), _y(n), _z(n){ }
+
+	// as for `std::vector`
+	std::size_t size() const { return _x.size(); }
+	bool empty() const { return _x.empty(); }
+
+	void resize(const std::size_t n){
+		_x.resize(n);
+		_y.resize(n);
+		_z.resize(n);
+	}
+
+	void swap(PositionArray &other){
+		_x.swap(other._x);
+		_y.swap(other._y);
+		_z.swap(other._z);
+	}
+
+	// the arrays of each coordinate
+	double* X(){ return _x.data(); }
+	double* Y(){ return _y.data(); }
+	double* Z(){ return _z.data(); }
+	const double* X() const { return _x.data(); }
+	const double* Y() const { return _y.data(); }
+	const double* Z() const { return _z.data(); }
+
+	// position `i` (a copy) and replacing it
+	Vector operator[](const std::size_t i) const {
+		return Vector(_x[i], _y[i], _z[i]); }
+
+	void Set(const std::size_t i, const double x, const double y,
+		const double z){
+		_x[i] = x;
+		_y[i] = y;
+		_z[i] = z;
+	}
+
+	void Set(const std::size_t i, const Vector &position){
+		Set(i, position.X(), position.Y(), position.Z()); }
+
+	// the coordinate `axis` ("X", "Y", "Z", "R", "Rho", "Phi" or "Theta") of
+	// the first `n` positions into `out`, without a branch inside the loops
+	// so that they vectorize
+	void Coordinate(const std::string &axis, const std::size_t n,
+		double *out) const {
+
+		const double *x = X(), *y = Y(), *z = Z();
+
+		if ( axis == "X" || axis == "Y" || axis == "Z" ){
+
+			const double *from = axis == "X" ? x : axis == "Y" ? y : z;
+
+			#pragma omp simd
+			for ( std::size_t i = 0; i < n; i++ ) out[i] = from[i];
+		}
+
+		else if ( axis == "R" ){
+			#pragma omp simd
+			for ( std::size_t i = 0; i < n; i++ )
+				out[i] = sqrt(x[i] * x[i] + y[i] * y[i]);
+		}
+
+		else if ( axis == "Rho" ){
+			#pragma omp simd
+			for ( std::size_t i = 0; i < n; i++ )
+				out[i] = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		}
+
+		// atan2 and acos have corner cases, these stay scalar
+		else if ( axis == "Phi" )
+			for ( std::size_t i = 0; i < n; i++ ) out[i] = (*this)[i].Phi();
+
+		else if ( axis == "Theta" )
+			for ( std::size_t i = 0; i < n; i++ ) out[i] = (*this)[i].Theta();
+
+		else throw Exception("From PositionArray::Coordinate(), `" + axis +
+			"` is not a coordinate!");
+	}
+
+	// the smallest squared distance from position `i` to the others among
+	// positions [first, last)
+	double Nearest(const std::size_t i, const std::size_t first,
+		const std::size_t last) const {
+
+		const double *x = X(), *y = Y(), *z = Z();
+		const double a = x[i], b = y[i], c = z[i];
+
+		double best = HUGE_VAL;
+
+		// the two sides of `i` so the loops have no branch
+		std::size_t middle = i < first ? first : i > last ? last : i;
+
+		#pragma omp simd reduction(min:best)
+		for ( std::size_t j = first; j < middle; j++ ){
+			double dx = a - x[j], dy = b - y[j], dz = c - z[j];
+			best = std::min(best, dx * dx + dy * dy + dz * dz);
+		}
+
+		std::size_t after = middle == i ? i + 1 : middle;
+
+		#pragma omp simd reduction(min:best)
+		for ( std::size_t j = after; j < last; j++ ){
+			double dx = a - x[j], dy = b - y[j], dz = c - z[j];
+			best = std::min(best, dx * dx + dy * dy + dz * dz);
+		}
+
+		return best;
+	}
+
+private:
+
+	Stream _x, _y, _z;
+};
+
+} // namespace Gaia
+
+#endif
@@ -12,8 +12,10 @@
 #include <map>
 
 #include <Vector.hpp>
+#include <Point.hpp>
 #include <Interpolate.hpp>
 #include <Parser.hpp>
+#include <Random.hpp>
 
 namespace Gaia {
 
@@ -21,21 +23,90 @@ class ProfileBase {
 
 public:
 
+	// what a profile depends on: anything, only R and Z, only Rho or only Z
+	enum Symmetry { NONE, AXISYMMETRIC, SPHERICAL, PLANAR };
+
 	// construct `Profile` with a name and axis information
 	ProfileBase(const std::string &name, const std::string &axis1 = "",
 		const std::string &axis2 = "");
 
-    ~ProfileBase();
+    virtual ~ProfileBase();
 
+	// read the table in `filename`: text with two columns or rows (1D) or
+	// more (2D), or a density cube over the X, Y and Z of the `box` as a
+	// Gaia binary file of kind "cube" or a FITS image with three axes (3D)
 	void Initialize(std::string &filename);
 
 	std::string Name(){return _name;}
 
 	// analytical `Function` is unique to each derived `Profile`
-	virtual double Function(const Vector &vec){ return 1.0; }
-
-	// generalized accessor function chooses what to do
-	double Evaluate(const Vector &vec);
+	virtual double Function(const Point &point){ return 1.0; }
+
+	// generalized accessor function chooses what to do, pass the same
+	// `Point` to every profile to share its derived coordinates
+	double Evaluate(const Point &point);
+	double Evaluate(const Vector &vec){ return Evaluate( Point(vec) ); }
+
+	// the values at `n` positions given by their coordinates; `Batched`
+	// profiles compute them together, the rest one `Point` at a time (other
+	// tables can be batched too, but only ask for the blocked build when
+	// another profile does so that seeded populations stay the same)
+	virtual void Batch(const double *x, const double *y, const double *z,
+		const std::size_t n, double *out);
+	virtual bool Batched() const { return _3D; }
+
+	// the `Function` is used (no data from a file)
+	bool Analytical() const { return _analytical; }
+
+	// the probability that rejection keeps a position where a profile is `f`
+	static double Keep(const double f){
+		return f < 0.0 ? 0.0 : f > 1.0 ? 1.0 : f; }
+
+	// declared by an analytical profile, otherwise from the axes of its data
+	Symmetry GetSymmetry() const;
+
+	// Profiles that can draw positions straight from their own `Function`
+	// override these. PrepareSampler() is called once if the profile is
+	// chosen to propose the positions (false means it has no sampler), then
+	// Sample() draws from a region that covers the `box` (the caller drops
+	// the positions outside of it).
+	virtual bool PrepareSampler(){ return false; }
+	virtual Vector Sample(ParallelMT *source, const int thread){
+		return Vector(); }
+
+	// set up the sampler of the profile (false if it has none) and draw from
+	// it: the `Sample` of an analytical profile, or for a table in X and Y
+	// an alias table over its cells (uniform in Z)
+	bool StartSampler();
+	Vector Propose(ParallelMT *source, const int thread);
+
+protected:
+
+	// set in the constructor of an analytical profile (NONE by default)
+	Symmetry symmetry;
+
+	// limits of the `box` along `X`, `Y` or `Z`, and the largest `R` in it
+	const std::vector<double>& BoxLimits(const std::string &axis) const {
+		return Limits.at(axis); }
+	double MaxR() const;
+
+	// inverse transforms for samplers (`u` uniform in [0, 1])
+	// density exp(-|z| / scale) on [lower, upper]
+	static double Laplace(const double u, const double scale,
+		const double lower, const double upper);
+	// density r^index on [lower, upper]
+	static double PowerLaw(const double u, const double index,
+		const double lower, const double upper);
+	// normal(mean, sigma) on [lower, upper] (throws if it has no mass there)
+	static double TruncatedNormal(const double u, const double mean,
+		const double sigma, const double lower, const double upper);
+
+	// density (1 - t) a + t b on [0, 1]
+	static double LinearDensity(const double u, const double a, const double b);
+
+	// `R` of an exponential disk, density R exp(-R / scale), up to `limit`
+	static double ExponentialDisk(ParallelMT *source, const int thread,
+		const double scale, const double limit);
 
 private:
 
@@ -53,26 +124,33 @@ private:
 	// 1D data (`x` is not necessarily x and y = f(x) )
 	std::vector<double> _x, _y;
 
+	// the third axis of a cube
+	std::vector<double> _z;
+
 	// limits needed to construct line-space given a 2D profile
 	std::map< std::string, std::vector<double> > Limits;
 
 	// map of functions, axis1 and axis2
-	std::map< std::string, double (*)(const Vector&) > Coord;
+	std::map< std::string, double (*)(const Point&) > Coord;
 
-	// functions in the above map (calls to vector coordinates)
-	static double X(const Vector &vec)     { return vec.X();     }
-	static double Y(const Vector &vec)     { return vec.Y();     }
-	static double Z(const Vector &vec)     { return vec.Z();     }
-	static double R(const Vector &vec)     { return vec.R();     }
-	static double Rho(const Vector &vec)   { return vec.Rho();   }
-	static double Phi(const Vector &vec)   { return vec.Phi();   }
-	static double Theta(const Vector &vec) { return vec.Theta(); }
+	// functions in the above map (calls to point coordinates)
+	static double X(const Point &point)     { return point.X();     }
+	static double Y(const Point &point)     { return point.Y();     }
+	static double Z(const Point &point)     { return point.Z();     }
+	static double R(const Point &point)     { return point.R();     }
+	static double Rho(const Point &point)   { return point.Rho();   }
+	static double Phi(const Point &point)   { return point.Phi();   }
+	static double Theta(const Point &point) { return point.Theta(); }
+
+	// the entries of `Coord` for axis1 and axis2 (looked up once)
+	double (*_coord1)(const Point&);
+	double (*_coord2)(const Point&);
 
 	// given axis from derived class constructor
 	std::string _axis1, _axis2;
 
-	// flags to signify 1D or 2D
-	bool _1D, _2D;
+	// flags to signify 1D, 2D or 3D
+	bool _1D, _2D, _3D;
 
 	// flag to signify analyticity
 	bool _analytical;
@@ -80,9 +158,23 @@ private:
 	// member interpolators
 	Interpolate::Linear<double>   *Linear_Data;
 	Interpolate::BiLinear<double> *BiLinear_Data;
+	Interpolate::BiCubic<double>  *BiCubic_Data;
+	Interpolate::TriLinear<double> *TriLinear_Data;
+
+	// cells of a 2D table weighted by their mass (axes Y, X if `_swap`)
+	AliasTable *_alias;
+	bool _swap;
 
-	// helper function for Initialize()
+	// helper functions for Initialize(), the cube is read if `filename` is a
+	// binary or FITS file (false otherwise)
 	std::vector<double> Linespace(const double, const double, const std::size_t);
+	bool ReadCube(const std::string &filename);
+
+	// the `axis` coordinate of `n` positions for Batch(), X, Y and Z as
+	// given and the others computed into scratch space `slot` (0 or 1)
+	static const double* Coordinates(const std::string &axis,
+		double (*coord)(const Point&), const double *x, const double *y,
+		const double *z, const std::size_t n, const int slot);
 };
 
 } // namespace Gaia
@@ -0,0 +1,70 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/ProfileCache.hpp
+//
+// Header file for the `ProfileCache` class. Parsing a large text table for a
+// `Profile` on every run is expensive. After the first parse, the table is
+// written as a compact binary image (a `.cache` file). Later runs map the
+// image directly into memory if the source file has not changed (same
+// modification time, size and hash).
+
+#ifndef _PROFILECACHE_HH_
+#define _PROFILECACHE_HH_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Gaia {
+
+class ProfileCache {
+
+public:
+
+	// `source` is the text file, `directory` (optional) an alternative
+	// location for the cache image (defaults to next to the source)
+	ProfileCache(const std::string &source, const std::string &directory = "",
+		const std::string &axis1 = "", const std::string &axis2 = "");
+	~ProfileCache(){}
+
+	// map an existing image into `data` if the key matches
+	bool Load(std::vector< std::vector<double> > &data);
+
+	// write a new image for `data` (failure is not an error)
+	bool Save(const std::vector< std::vector<double> > &data);
+
+	std::string Path() const {return _path;}
+
+	// header of the binary image (padded to 64 bytes)
+	struct Header {
+
+		char          magic[8];   // "GAIAPRF"
+		std::uint32_t version;    // format version
+		std::uint32_t byte_order; // 0x01020304 in native order
+		std::uint64_t rows, cols; // dimensions of the table
+		std::int64_t  mtime;      // modification time of source (ns)
+		std::uint64_t size;       // size of source in bytes
+		std::uint64_t hash;       // FNV-1a hash of source contents
+		char          axis1[4];   // axis names given by the `Profile`
+		char          axis2[4];
+	};
+
+private:
+
+	// identify the source file, false if it cannot be read
+	bool Key();
+
+	// 64-bit FNV-1a hash of a block of memory
+	static std::uint64_t Hash(const unsigned char*, std::size_t);
+
+	std::string _source, _path, _axis1, _axis2;
+
+	// key for the source file
+	std::int64_t  _mtime;
+	std::uint64_t _size, _hash;
+	bool _keyed;
+};
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/ProfileChain.hpp
+//
+// Header file for the `ProfileChain` template. `Build` normally tests a
+// candidate against each profile in `ProfileManager::UsedPDFs` through a
+// virtual `Function`, so nothing is inlined across them. A chain names the
+// profile classes at compile time, `ProfileChain<MilkyWay, Spiral>`, and
+// calls their `Function`s directly (qualified, not virtual), so the whole
+// test is one function the compiler can inline and fuse; the batched
+// `Product` over many positions is a plain loop that can vectorize. The
+// combinations to compile are listed in `ProfileManager::Initialize()` when
+// built with `make CHAINS=1`. One of them is used when the profiles given in
+// the rc file are exactly its classes, otherwise the runtime loop is.
+
+#ifndef _PROFILECHAIN_HH_
+#define _PROFILECHAIN_HH_
+
+#include <cstddef>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <ProfileBase.hpp>
+#include <Point.hpp>
+#include <Random.hpp>
+#include <Vector.hpp>
+
+namespace Gaia {
+
+// what the rest of Gaia sees of a chain (one virtual call per candidate)
+class ChainBase {
+
+public:
+
+	virtual ~ChainBase(){ }
+
+	// the candidate passes every profile but `skip` (the sampler), tested
+	// in the order of the chain exactly as `Build` tests them in turn
+	virtual bool Accept(const Point &point, ParallelMT *source,
+		const int thread, const ProfileBase *skip) const = 0;
+
+	// product of the profiles at one, or at `n`, positions (each clipped to
+	// [0, 1], as the rejection test uses them)
+	virtual double Product(const Point &point) const = 0;
+	virtual void Product(const Vector *positions, const std::size_t n,
+		double *out) const = 0;
+
+	// the profiles in the order of the chain, e.g. `MilkyWay x Spiral`
+	virtual std::string Describe() const = 0;
+};
+
+// one link for each class in the chain, the last is empty
+template <class... Profiles> struct ChainLinks;
+
+template <> struct ChainLinks<> {
+
+	bool Bind(const std::vector<ProfileBase*> &used){ return true; }
+
+	bool Accept(const Point &point, ParallelMT *source, const int thread,
+		const ProfileBase *skip) const { return true; }
+
+	double Product(const Point &point) const { return 1.0; }
+
+	std::string Describe() const { return ""; }
+};
+
+template <class Profile, class... Rest> struct ChainLinks<Profile, Rest...> {
+
+	Profile *profile;
+	ChainLinks<Rest...> rest;
+
+	// the profile in `used` whose class is exactly `Profile`
+	bool Bind(const std::vector<ProfileBase*> &used){
+
+		profile = nullptr;
+
+		for ( const auto& pdf : used )
+			if ( typeid(*pdf) == typeid(Profile) )
+				profile = static_cast<Profile*>(pdf);
+
+		return profile && rest.Bind(used);
+	}
+
+	// a table from a file goes through `Evaluate`, as it would at runtime
+	double Value(const Point &point) const {
+		return profile -> Analytical() ? profile -> Profile::Function(point)
+			: profile -> Evaluate(point);
+	}
+
+	bool Accept(const Point &point, ParallelMT *source, const int thread,
+		const ProfileBase *skip) const {
+
+		if ( profile != skip && Value(point) < source -> RandomReal(thread) )
+			return false;
+
+		return rest.Accept(point, source, thread, skip);
+	}
+
+	double Product(const Point &point) const {
+		return ProfileBase::Keep(Value(point)) * rest.Product(point);
+	}
+
+	std::string Describe() const {
+		std::string others = rest.Describe();
+		return profile -> Name() + ( others.empty() ? "" : " x " + others );
+	}
+};
+
+template <class... Profiles>
+class ProfileChain: public ChainBase {
+
+public:
+
+	// a chain over `used` if its profiles are exactly `Profiles...` (each
+	// once), otherwise nullptr
+	static ChainBase* Compose(const std::vector<ProfileBase*> &used){
+
+		ProfileChain *chain = new ProfileChain();
+
+		if ( used.size() != sizeof...(Profiles) ||
+			!chain -> _links.Bind(used) ){
+
+			delete chain;
+			return nullptr;
+		}
+
+		return chain;
+	}
+
+	virtual bool Accept(const Point &point, ParallelMT *source,
+		const int thread, const ProfileBase *skip) const {
+		return _links.Accept(point, source, thread, skip);
+	}
+
+	virtual double Product(const Point &point) const {
+		return _links.Product(point);
+	}
+
+	virtual void Product(const Vector *positions, const std::size_t n,
+		double *out) const {
+
+		#pragma omp simd
+		for ( std::size_t i = 0; i < n; i++ )
+			out[i] = _links.Product( Point(positions[i]) );
+	}
+
+	virtual std::string Describe() const { return _links.Describe(); }
+
+private:
+
+	ProfileChain(){ }
+
+	ChainLinks<Profiles...> _links;
+};
+
+} // namespace Gaia
+
+#endif
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include <ProfileBase.hpp>
+#include <ProfileChain.hpp>
 
 namespace Gaia {
 
@@ -24,6 +25,27 @@ public:
     // maintain list `used` PDFs
     std::vector<ProfileBase*> UsedPDFs;
 
+    // the most selective used profile with a sampler proposes the positions
+    // (nullptr if none, or with --no-sampler or quasi-random --proposals)
+    ProfileBase *Sampler;
+
+    // the compiled chain over exactly the used profiles (`make CHAINS=1`),
+    // nullptr if none of the combinations in Initialize() matches
+    ChainBase *Chain;
+
+    // some profile tested in `Build` evaluates blocks of candidates at once
+    bool Batched() const;
+
+    // all used profiles depend on R and Z only (see ProfileBase::Symmetry)
+    bool Axisymmetric() const;
+
+    // With `--reorder`, re-sort `UsedPDFs` so that `Build` tests them in the
+    // order with the least expected cost per candidate. Each profile is timed
+    // and evaluated on a warm-up set of candidates (from the sampler if there
+    // is one); `given` and `chosen` return the expected time (s) spent on the
+    // profiles per candidate in the original and the new order.
+    void Reorder(double &given, double &chosen);
+
 };
 
 } // namespace Gaia
@@ -7,14 +7,39 @@
 // is nothing to do but declare it. If your profile has some unique analytical
 // form, overload the `Function` definition. The template is
 //
-//     virtual double Function(const Vector&);
+//     virtual double Function(const Point&);
+//
+// A `Point` is a `Vector` that keeps its `R`, `Rho`, `Phi` and `Theta` once
+// computed, so call them as often as is convenient.
+//
+// Declare the `symmetry` of an analytical profile in its constructor if it
+// only depends on R and Z (AXISYMMETRIC), on Rho (SPHERICAL) or on Z
+// (PLANAR); when all profiles in use do, `--envelope` draws positions from
+// a table in (R, Z) instead of the whole `box` (for profiles that are smooth
+// over its cells).
+//
+// If positions can be drawn straight from the `Function` (by inverse
+// transform), also overload `PrepareSampler` and `Sample` (see `MilkyWay`,
+// `Habitability` and `Halo`); the population is then built from those
+// positions and only the other profiles reject. A table in (X, Y) proposes
+// from its own surface when all of its values are within [0, 1] (a position
+// is otherwise kept with probability min(f, 1), which a sampler can't
+// follow), so normalize a table to a largest value of 1 to have it propose.
+//
+// A simple analytical profile can instead be given in the rc file, with
+// `define Name "expression"` and `include Name`, without rebuilding (see
+// `Expression.hpp`). A compiled one can be loaded from a shared library
+// with `include plugin:libmydisk.so` (see `Plugin.hpp` and the example in
+// `Plugins/`).
 //
 // Following and/or remake the below examples... (and stay in the namespace!).
 
+#include <algorithm>
 #include <cmath>
 
 #include <ProfileBase.hpp>
 #include <Vector.hpp>
+#include <Point.hpp>
 
 namespace Gaia {
 
@@ -26,26 +51,72 @@ namespace Gaia {
 class MilkyWay: public ProfileBase {
 public:
 
-    MilkyWay(): ProfileBase("MilkyWay"){ }
+    MilkyWay(): ProfileBase("MilkyWay"){ symmetry = AXISYMMETRIC; }
 
-    virtual double Function(const Vector& p){
+    // thin disk parameterization:
+    // z_d = 0.3 +/- 0.?? kpc
+    // r_d = 2.6 +/- 0.52 kpc
+    //
+    // thick disk parameterization:
+    // z_d = 0.9 +/- 0.?? kpc
+    // r_d = 3.6 +/- 0.72 kpc
+    const double z_d[2] = { 0.3, 0.9 };
+    const double r_d[2] = { 2.6, 3.6 };
+
+    virtual double Function(const Point& p){
 
         // constant in front is pseudo-normalization parameter
         return 0.2 * (
 
-            // thin disk parameterization:
-            // z_d = 0.3 +/- 0.?? kpc
-            // r_d = 2.6 +/- 0.52 kpc
-            std::exp( -std::abs( p.Z() ) / 0.3 - p.R() / 2.6 ) / 0.3
+            std::exp( -std::abs( p.Z() ) / z_d[0] - p.R() / r_d[0] ) / z_d[0]
 
             +
 
-            // thick disk parameterization:
-            // z_d = 0.9 +/- 0.?? kpc
-            // r_d = 3.6 +/- 0.72 kpc
-            std::exp( -std::abs( p.Z() ) / 0.9 - p.R() / 3.6 ) / 0.9
+            std::exp( -std::abs( p.Z() ) / z_d[1] - p.R() / r_d[1] ) / z_d[1]
             );
     }
+
+    // each disk is exp(-R / r_d) in the plane and exp(-|z| / z_d) in height,
+    // the thin one is chosen with the fraction of the mass in the `box`
+    virtual bool PrepareSampler(){
+
+        z_limits = BoxLimits("Z");
+        R_max    = MaxR();
+
+        double mass[2];
+        for ( int k = 0; k < 2; k++ ){
+
+            double h = z_d[k], x = R_max / r_d[k];
+
+            // integral of exp(-|z| / h) / h from -infinity
+            auto G = [h](double z){ return z < 0.0 ? std::exp(z / h) :
+                2.0 - std::exp(-z / h); };
+
+            // height and radial integrals (the radial one up to R_max)
+            mass[k] = (G(z_limits[1]) - G(z_limits[0])) * r_d[k] * r_d[k] *
+                (1.0 - (1.0 + x) * std::exp(-x));
+        }
+
+        thin = mass[0] / (mass[0] + mass[1]);
+        return true;
+    }
+
+    virtual Vector Sample(ParallelMT *source, const int thread){
+
+        int k = source -> RandomReal(thread) < thin ? 0 : 1;
+
+        double R   = ExponentialDisk(source, thread, r_d[k], R_max);
+        double phi = 2.0 * 3.141592653589793 * source -> RandomReal(thread);
+        double z   = Laplace(source -> RandomReal(thread), z_d[k],
+            z_limits[0], z_limits[1]);
+
+        return Vector(R * std::cos(phi), R * std::sin(phi), z);
+    }
+
+private:
+
+    std::vector<double> z_limits;
+    double R_max, thin;
 };
 
 // model spirals
@@ -54,7 +125,7 @@ public:
 
     Spiral(): ProfileBase("Spiral"){ }
 
-    virtual double Function(const Vector &p){
+    virtual double Function(const Point &p){
 
         double n   = 1.0;
         double Rs  = 16.863;
@@ -69,9 +140,9 @@ public:
 class Metallicity: public ProfileBase {
 public:
 
-    Metallicity(): ProfileBase("Metallicity"){ }
+    Metallicity(): ProfileBase("Metallicity"){ symmetry = AXISYMMETRIC; }
 
-    virtual double Function( const Vector& p ){
+    virtual double Function( const Point& p ){
 
         double No    =  0.452322; // normalization coefficient
         double base  =  0.760000; // base level
@@ -89,17 +160,108 @@ public:
 class Habitability: public ProfileBase {
 public:
 
-	Habitability(): ProfileBase("Habitability"){ }
+	Habitability(): ProfileBase("Habitability"){ symmetry = AXISYMMETRIC; }
 
-	virtual double Function(const Vector& position){
+	const double N_0   = 0.01; // normalization coefficient
+	const double sigma = 300;  // bandwidth for profile
+	const double R_c   = 7500; // orbit of co-rotation
 
-		double N_0   = 0.01; // normalization coefficient
-		double sigma = 300;  // bandwidth for profile
-		double R_c   = 7500; // orbit of co-rotation
+	virtual double Function(const Point& position){
 
 		// Gaussian around orbit of co-rotation
 		return N_0 * exp(-pow(position.R() - R_c, 2.0) / (2.*sigma*sigma));
 	}
+
+	// a Gaussian in R (times R for the area), uniform in phi and z
+	virtual bool PrepareSampler(){
+
+		z_limits = BoxLimits("Z");
+		R_max    = MaxR();
+
+		// fails here (not while building) if the ring misses the `box`
+		TruncatedNormal(0.5, R_c, sigma, 0.0, R_max);
+		return true;
+	}
+
+	virtual Vector Sample(ParallelMT *source, const int thread){
+
+		double R;
+
+		do R = TruncatedNormal(source -> RandomReal(thread), R_c, sigma, 0.0,
+			R_max);
+		while ( source -> RandomReal(thread) * R_max > R );
+
+		double phi = 2.0 * 3.141592653589793 * source -> RandomReal(thread);
+		double z   = z_limits[0] + (z_limits[1] - z_limits[0]) *
+			source -> RandomReal(thread);
+
+		return Vector(R * std::cos(phi), R * std::sin(phi), z);
+	}
+
+private:
+
+	std::vector<double> z_limits;
+	double R_max;
+};
+
+// Power law halo (spherical), flat inside of its core
+class Halo: public ProfileBase {
+public:
+
+	Halo(): ProfileBase("Halo"){ symmetry = SPHERICAL; }
+
+	const double alpha = 2.5; // slope of the density outside the core
+	const double r_c   = 1.0; // core radius (kpc)
+
+	virtual double Function(const Point& p){
+
+		return p.Rho() < r_c ? 1.0 : std::pow(p.Rho() / r_c, -alpha);
+	}
+
+	// Rho^2 (for the volume) in the core and Rho^(2 - alpha) outside of it,
+	// each with the fraction of the mass within the `box`, in a random
+	// direction
+	virtual bool PrepareSampler(){
+
+		const std::vector<double> &z = BoxLimits("Z");
+		double max_Z = std::max(std::abs(z[0]), std::abs(z[1]));
+
+		Rho_max = std::sqrt(MaxR() * MaxR() + max_Z * max_Z);
+
+		if ( Rho_max <= r_c ){
+
+			core = 1.0;
+			return true;
+		}
+
+		double inner = r_c * r_c * r_c / 3.0;
+		double outer = std::abs(alpha - 3.0) < 1e-12 ?
+			r_c * r_c * r_c * std::log(Rho_max / r_c) :
+			std::pow(r_c, alpha) * (std::pow(Rho_max, 3.0 - alpha) -
+			std::pow(r_c, 3.0 - alpha)) / (3.0 - alpha);
+
+		core = inner / (inner + outer);
+		return true;
+	}
+
+	virtual Vector Sample(ParallelMT *source, const int thread){
+
+		double Rho = source -> RandomReal(thread) < core ?
+			PowerLaw(source -> RandomReal(thread), 2.0, 0.0,
+				std::min(r_c, Rho_max)) :
+			PowerLaw(source -> RandomReal(thread), 2.0 - alpha, r_c, Rho_max);
+
+		double mu  = 2.0 * source -> RandomReal(thread) - 1.0;
+		double phi = 2.0 * 3.141592653589793 * source -> RandomReal(thread);
+		double s   = std::sqrt(1.0 - mu * mu);
+
+		return Vector(Rho * s * std::cos(phi), Rho * s * std::sin(phi),
+			Rho * mu);
+	}
+
+private:
+
+	double Rho_max, core;
 };
 
 // Example for NGC1300 from HST FITS image ...
@@ -109,4 +271,11 @@ public:
 	Surface(): ProfileBase("Surface", "X", "Y"){ }
 };
 
+// Example of a density cube (a binary or FITS file) over the whole `box` ...
+class Density: public ProfileBase {
+public:
+
+	Density(): ProfileBase("Density"){ }
+};
+
 } // namespace Gaia
@@ -2,13 +2,14 @@
 // GNU General Public License v3.0
 // Include/Random.hpp
 //
-// This header file contains the declarations for the MT19937 object and its
-// wrapper class ParallelMT
+// This header file contains the declarations for the MT19937 object, its
+// wrapper class ParallelMT and the QuasiRandom proposal streams
 
 #ifndef _RANDOM_HH_
 #define _RANDOM_HH_
 
 #include <vector>
+#include <cstdint>
 
 #define NN       312
 #define MM       156
@@ -35,6 +36,10 @@ public:
 	unsigned long long RandomInteger();
 	double RandomReal();
 
+	// the state as NN + 1 words (`mt` then `mti`), and back
+	void GetState(std::vector<unsigned long long> &state) const;
+	void SetState(const unsigned long long *state);
+
 protected:
 
 	// the array for the state vector
@@ -57,6 +62,10 @@ public:
 	double RandomReal(const int thread) const;
     double RandomReal(const int thread, const std::vector<double> &limits) const;
 
+	// the state of all generators (for checkpoints), and back
+	std::vector<unsigned long long> GetState() const;
+	void SetState(const std::vector<unsigned long long> &state);
+
 protected:
 
 	void Cycle(unsigned long long init_key[], int key_length);
@@ -64,6 +73,70 @@ protected:
 	int _threads;
 };
 
+// Walker's alias method (with Vose's construction): an index is drawn with
+// probability proportional to its weight in constant time.
+class AliasTable {
+
+public:
+
+	AliasTable(const std::vector<double> &weights);
+
+	// an index, from two uniform deviates
+	std::size_t Pick(const double u1, const double u2) const;
+
+	std::size_t Size() const { return _alias.size(); }
+
+protected:
+
+	std::vector<double> _probability;
+	std::vector<std::size_t> _alias;
+};
+
+// Scrambled low discrepancy sequences in the unit cube (`--proposals`). The
+// Sobol sequence gets a random digital shift, the Halton sequence (bases 2,
+// 3 and 5) a random permutation of the digits in each base; either way
+// every point is still uniform and the set stays evenly spread. Any point
+// can be computed directly from its index so each thread takes its own
+// block of 2^QMC_BLOCK_BITS indices.
+#define QMC_BLOCK_BITS 40
+
+class QuasiRandom {
+
+public:
+
+	enum Sequence { SOBOL, HALTON };
+
+	QuasiRandom(const Sequence sequence, const int threads,
+		const unsigned long long seed);
+
+	// scramble anew for `epoch` (a randomized restart) and put every
+	// thread back at the start of its block
+	void Restart(const unsigned long long epoch);
+
+	// the next point of `thread`
+	void Next(const int thread, double point[3]);
+
+	// point `index` of the scrambled sequence
+	void Point(const std::uint64_t index, double point[3]) const;
+
+	// the epoch and the position of each thread (for checkpoints), and back
+	std::vector<unsigned long long> GetState() const;
+	void SetState(const std::vector<unsigned long long> &state);
+
+protected:
+
+	Sequence _sequence;
+	unsigned long long _seed, _epoch;
+	std::vector<std::uint64_t> _next;
+
+	// Sobol direction numbers and the digital shift
+	std::uint64_t _direction[3][64], _shift[3];
+
+	// Halton digit permutations (and digits needed for double precision)
+	std::vector<int> _permutation[3];
+	int _digits[3];
+};
+
 } // namespace Gaia
 
 #endif
@@ -0,0 +1,106 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/TextWriter.hpp
+//
+// Header file for the `TextWriter` class. Text output used to go through an
+// `std::ofstream` with `precision(16)` and an `std::endl` (a flush) for every
+// line. The `TextWriter` formats each number with the shortest string that
+// parses back to exactly the same double (Grisu2, after Loitsch 2010), builds
+// chunks of lines in parallel and writes them in large blocks.
+
+#ifndef _TEXTWRITER_HH_
+#define _TEXTWRITER_HH_
+
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include <Exception.hpp>
+
+// lines formatted by each thread before a block is written
+#define TEXT_CHUNK 16384
+
+namespace Gaia {
+
+class TextWriter {
+
+public:
+
+	// write the shortest round-trip representation of `value` into `buffer`
+	// (which needs at least 32 bytes) and return the end of the string
+	static char* Format(double value, char *buffer);
+
+	// convenience for one value
+	static std::string Format(double value);
+
+	// write `rows` lines of `columns` values to `filename`, element (i, j)
+	// given by `get(i, j)`; lines are space delimited
+	template<class Accessor>
+	static void Write(const std::string &filename, const std::size_t rows,
+		const std::size_t columns, Accessor get);
+
+	// overload for a set of contiguous columns
+	static void Write(const std::string &filename,
+		const std::vector<const double*> &columns, const std::size_t rows);
+};
+
+template<class Accessor>
+void TextWriter::Write(const std::string &filename, const std::size_t rows,
+	const std::size_t columns, Accessor get){
+
+	FILE *output = std::fopen(filename.c_str(), "wb");
+
+	if ( !output ) throw IOError("From TextWriter::Write(), I couldn't "
+		"open the file `" + filename + "`!");
+
+	int threads = omp_get_max_threads();
+	std::vector<std::string> chunk(threads);
+	bool good = true;
+
+	// each pass formats up to `threads` chunks then writes them in order
+	for ( std::size_t first = 0; good && first < rows;
+		first += threads * TEXT_CHUNK ){
+
+		#pragma omp parallel for
+		for ( int t = 0; t < threads; t++ ){
+
+			std::size_t start = first + t * TEXT_CHUNK;
+			std::size_t end   = std::min(start + TEXT_CHUNK, rows);
+
+			std::string &text = chunk[t];
+			text.clear();
+
+			if ( start >= end ) continue;
+
+			text.resize( (end - start) * columns * 26 );
+			char *cursor = &text[0];
+
+			for ( std::size_t i = start; i < end; i++ ){
+
+				for ( std::size_t j = 0; j < columns; j++ ){
+
+					if ( j ) *cursor++ = ' ';
+					cursor = Format(get(i, j), cursor);
+				}
+
+				*cursor++ = '\n';
+			}
+
+			text.resize( cursor - &text[0] );
+		}
+
+		for ( const auto& text : chunk )
+			if ( good && !text.empty() ) good = std::fwrite(text.data(), 1,
+				text.size(), output) == text.size();
+	}
+
+	if ( std::fclose(output) || !good )
+		throw IOError("From TextWriter::Write(), I failed writing to `" +
+		filename + "`!");
+}
+
+} // namespace Gaia
+
+#endif
@@ -0,0 +1,101 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Include/VoxelCache.hpp
+//
+// Header file for the `VoxelCache` class. With `--voxel-cache` the product
+// of all the profiles in use (each clipped to [0, 1]) is evaluated once (in
+// parallel) on a regular 3D grid over the `box`, and candidates are then tested against its trilinear
+// interpolation instead of every profile. The grid is refined (doubled)
+// until the interpolation error at the centers of the voxels is within
+// `--voxel-tolerance` of the largest value. The largest corner of each voxel
+// bounds the interpolation inside it, so voxels are also drawn from an
+// alias table weighted by that bound and only candidates in dim voxels are
+// rejected. The grid is saved to `--voxel-path` and reused by later runs
+// with the same profiles, `box`, resolution and tolerance.
+
+#ifndef _VOXELCACHE_HH_
+#define _VOXELCACHE_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ProfileBase.hpp>
+#include <ProfileChain.hpp>
+#include <Random.hpp>
+#include <Vector.hpp>
+
+// largest number of voxels refinement goes to
+#define VOXEL_MAX_CELLS (1 << 24)
+
+namespace Gaia {
+
+class VoxelCache {
+
+public:
+
+	// `key` identifies the profiles (names, files), `path` is the image on
+	// disk (none if empty), the grid is filled by the compiled `chain` over
+	// the profiles if there is one
+	VoxelCache(const std::vector<ProfileBase*> &profiles,
+		const std::vector<double> &X, const std::vector<double> &Y,
+		const std::vector<double> &Z, const std::size_t resolution,
+		const double tolerance, const std::string &key,
+		const std::string &path, const ChainBase *chain = nullptr);
+	~VoxelCache();
+
+	// trilinear interpolation of the product of the profiles
+	double Evaluate(const Vector &position) const;
+
+	// a candidate in a voxel drawn by its bound, and that bound
+	Vector Sample(ParallelMT *source, const int thread, double &bound) const;
+
+	// voxels per side, relative interpolation error and whether the grid
+	// was read from the image
+	std::size_t Resolution() const { return _n; }
+	double Error() const { return _error; }
+	bool Loaded() const { return _loaded; }
+
+	// header of the image (64 bytes, native byte order)
+	struct Header {
+
+		char          magic[8];   // "GAIAVOX"
+		std::uint32_t version;
+		std::uint32_t byte_order; // 0x01020304 in native order
+		std::uint64_t key;        // hash of the configuration
+		std::uint64_t n;          // voxels per side
+		double        error;
+		char          padding[24];
+	};
+
+private:
+
+	// evaluate the profiles on the nodes of an `n` voxel grid, and the
+	// error of the interpolation at the centers of the voxels
+	void Fill(const std::size_t n);
+	double Estimate() const;
+
+	// the bound of each voxel and the alias table over them
+	void Bounds();
+
+	bool Load(const std::string &path);
+	void Save(const std::string &path) const;
+
+	// product of the profiles
+	double Product(const Vector &position) const;
+
+	std::vector<ProfileBase*> _profiles;
+	const ChainBase *_chain;
+	double _origin[3], _span[3], _width[3];
+	std::size_t _n;
+	std::vector<double> _nodes, _bound;
+	AliasTable *_alias;
+
+	std::uint64_t _key;
+	double _error;
+	bool _loaded;
+};
+
+} // namespace Gaia
+
+#endif
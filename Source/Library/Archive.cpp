@@ -0,0 +1,298 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/Archive.cc
+//
+// Source file for the `Archive` class. See Include/Archive.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <Archive.hpp>
+#include <BinaryFile.hpp>
+#include <Exception.hpp>
+
+#define ARCHIVE_MAGIC   "GAIAARC"
+#define INDEX_MAGIC     "GAIAIDX"
+#define ARCHIVE_VERSION 1
+
+namespace Gaia {
+
+namespace {
+
+// first 64 bytes of the file
+struct FileHeader {
+
+	char          magic[8];
+	std::uint32_t version;
+	char          padding[52];
+};
+
+// last 32 bytes of a closed archive
+struct Trailer {
+
+	char          magic[8];
+	std::uint64_t count;   // number of entries in the index
+	std::uint64_t offset;  // of the first entry from start of file
+	char          padding[8];
+};
+
+// entries and trailer are stored little-endian
+void Swap(Archive::Entry &entry){
+
+	BinaryFile::Swap(&entry.trial,  4, 1);
+	BinaryFile::Swap(&entry.dtype,  4, 1);
+	BinaryFile::Swap(&entry.offset, 8, 1);
+	BinaryFile::Swap(&entry.bytes,  8, 1);
+}
+
+void Swap(Trailer &trailer){
+
+	BinaryFile::Swap(&trailer.count,  8, 1);
+	BinaryFile::Swap(&trailer.offset, 8, 1);
+}
+
+} // anonymous namespace
+
+static_assert(sizeof(FileHeader) == 64, "Archive header must be 64 bytes!");
+static_assert(sizeof(Trailer) == 32, "Archive trailer must be 32 bytes!");
+static_assert(sizeof(Archive::Entry) == 32, "Archive entry must be 32 bytes!");
+
+Archive::Archive(const std::string &filename, const bool append){
+
+	_filename = filename;
+
+	if ( append && IsArchive(filename) ){
+
+		// the index (and footer) are rewritten at the end
+		_index  = Index(filename);
+		_offset = sizeof(FileHeader);
+		for ( const auto& entry : _index )
+			_offset = std::max(_offset, entry.offset + entry.bytes);
+
+		_file = std::fopen(filename.c_str(), "r+b");
+
+		if ( !_file || ftruncate(fileno(_file), _offset) ||
+			std::fseek(_file, _offset, SEEK_SET) ) throw IOError("From "
+			"Archive::Archive(), I couldn't reopen `" + filename + "`!");
+
+		return;
+	}
+
+	_file = std::fopen(filename.c_str(), "wb");
+
+	if ( !_file ) throw IOError("From Archive::Archive(), I couldn't open "
+		"the file `" + filename + "`!");
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::strncpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ARCHIVE_VERSION;
+	if ( !BinaryFile::LittleEndian() ) BinaryFile::Swap(&header.version, 4, 1);
+
+	if ( std::fwrite(&header, sizeof(FileHeader), 1, _file) != 1 )
+		throw IOError("From Archive::Archive(), I failed writing to `" +
+		filename + "`!");
+
+	_offset = sizeof(FileHeader);
+}
+
+Archive::~Archive(){
+
+	// a footer is still useful if the run ended by an error
+	try { Close(); } catch (...) { }
+}
+
+void Archive::Discard(const std::size_t trial){
+
+	std::lock_guard<std::mutex> guard(_lock);
+
+	if ( !_file ) return;
+
+	// records are in trial order, keep up to the first one that goes
+	std::size_t keep = 0;
+	while ( keep < _index.size() && _index[keep].trial >= 1 &&
+		_index[keep].trial <= trial ) keep++;
+
+	_index.resize(keep);
+	_offset = keep ? _index.back().offset + _index.back().bytes :
+		sizeof(FileHeader);
+
+	if ( std::fflush(_file) || ftruncate(fileno(_file), _offset) ||
+		std::fseek(_file, _offset, SEEK_SET) ) throw IOError("From "
+		"Archive::Discard(), I failed truncating `" + _filename + "`!");
+}
+
+void Archive::Append(const BinaryFile::Header &header,
+	const std::vector<const double*> &columns){
+
+	std::lock_guard<std::mutex> guard(_lock);
+
+	if ( !_file ) throw IOError("From Archive::Append(), `" + _filename +
+		"` was already closed!");
+
+	Entry entry;
+	std::memset(&entry, 0, sizeof(Entry));
+	std::memcpy(entry.kind, header.kind, sizeof(entry.kind));
+	entry.trial  = header.trial;
+	entry.dtype  = header.dtype;
+	entry.offset = _offset;
+	entry.bytes  = BinaryFile::Write(_file, _filename, header, columns);
+
+	_offset += entry.bytes;
+	_index.push_back(entry);
+}
+
+void Archive::Close(){
+
+	std::lock_guard<std::mutex> guard(_lock);
+
+	if ( !_file ) return;
+
+	Trailer trailer;
+	std::memset(&trailer, 0, sizeof(Trailer));
+	std::strncpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+	trailer.count  = _index.size();
+	trailer.offset = _offset;
+
+	std::vector<Entry> stored = _index;
+
+	if ( !BinaryFile::LittleEndian() ){
+		for ( auto& entry : stored ) Swap(entry);
+		Swap(trailer);
+	}
+
+	bool good = stored.empty() || std::fwrite(stored.data(), sizeof(Entry),
+		stored.size(), _file) == stored.size();
+	good = good && std::fwrite(&trailer, sizeof(Trailer), 1, _file) == 1;
+	good = !std::fclose(_file) && good;
+	_file = nullptr;
+
+	if ( !good ) throw IOError("From Archive::Close(), I failed writing the "
+		"index to `" + _filename + "`!");
+}
+
+bool Archive::IsArchive(const std::string &filename){
+
+	FILE *input = std::fopen(filename.c_str(), "rb");
+	if ( !input ) return false;
+
+	char magic[8];
+	bool found = std::fread(magic, 8, 1, input) == 1 &&
+		!std::strncmp(magic, ARCHIVE_MAGIC, 8);
+
+	std::fclose(input);
+	return found;
+}
+
+std::vector<Archive::Entry> Archive::Index(const std::string &filename){
+
+	FILE *input = std::fopen(filename.c_str(), "rb");
+
+	if ( !input ) throw IOError("From Archive::Index(), I couldn't open "
+		"the file `" + filename + "`!");
+
+	std::vector<Entry> index;
+	bool swap = !BinaryFile::LittleEndian();
+
+	// size of the file
+	std::fseek(input, 0, SEEK_END);
+	long long length = std::ftell(input);
+
+	// look for the footer first
+	Trailer trailer;
+	std::memset(&trailer, 0, sizeof(Trailer));
+
+	if ( length >= (long long) (sizeof(FileHeader) + sizeof(Trailer)) ){
+
+		std::fseek(input, length - sizeof(Trailer), SEEK_SET);
+		if ( std::fread(&trailer, sizeof(Trailer), 1, input) != 1 )
+			std::memset(&trailer, 0, sizeof(Trailer));
+		if ( swap ) Swap(trailer);
+	}
+
+	if ( !std::strncmp(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic)) &&
+		trailer.offset + trailer.count * sizeof(Entry) + sizeof(Trailer) ==
+		(std::uint64_t) length ){
+
+		index.resize(trailer.count);
+		std::fseek(input, trailer.offset, SEEK_SET);
+
+		if ( trailer.count && std::fread(index.data(), sizeof(Entry),
+			trailer.count, input) != trailer.count ){
+
+			std::fclose(input);
+			throw IOError("From Archive::Index(), the index of `" +
+				filename + "` is truncated!");
+		}
+
+		if ( swap ) for ( auto& entry : index ) Swap(entry);
+
+	} else {
+
+		// no footer (the run was interrupted), walk the record headers
+		std::uint64_t offset = sizeof(FileHeader);
+		BinaryFile::Header header;
+
+		while ( offset + sizeof(header) <= (std::uint64_t) length ){
+
+			std::fseek(input, offset, SEEK_SET);
+			if ( std::fread(&header, sizeof(header), 1, input) != 1 ) break;
+			if ( swap ) BinaryFile::Swap(header);
+
+			Entry entry;
+			std::memset(&entry, 0, sizeof(Entry));
+			std::memcpy(entry.kind, header.kind, sizeof(entry.kind));
+			entry.trial  = header.trial;
+			entry.dtype  = header.dtype;
+			entry.offset = offset;
+			entry.bytes  = BinaryFile::Bytes(header);
+
+			// a partially written last record is dropped
+			if ( std::strncmp(header.magic, "GAIABIN", 8) ||
+				offset + entry.bytes > (std::uint64_t) length ) break;
+
+			index.push_back(entry);
+			offset += entry.bytes;
+		}
+	}
+
+	std::fclose(input);
+	return index;
+}
+
+BinaryFile::Header Archive::Read(const std::string &filename,
+	const std::string &kind, const std::size_t trial,
+	std::vector< std::vector<double> > &columns){
+
+	for ( const auto& entry : Index(filename) ){
+
+		if ( kind != std::string(entry.kind, strnlen(entry.kind, 8)) ||
+			entry.trial != trial ) continue;
+
+		FILE *input = std::fopen(filename.c_str(), "rb");
+
+		if ( !input ) throw IOError("From Archive::Read(), I couldn't open "
+			"the file `" + filename + "`!");
+
+		BinaryFile::Header header;
+		std::fseek(input, entry.offset, SEEK_SET);
+
+		try { header = BinaryFile::Read(input, filename, columns); }
+		catch (...) { std::fclose(input); throw; }
+
+		std::fclose(input);
+		return header;
+	}
+
+	std::stringstream warning;
+	warning << "From Archive::Read(), there is no `" << kind << "` record for ";
+	warning << "trial " << trial << " in `" << filename << "`!";
+	throw IOError( warning.str() );
+}
+
+} // namespace Gaia
@@ -0,0 +1,237 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/BinaryFile.cc
+//
+// Source file for the `BinaryFile` class. See Include/BinaryFile.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <vector>
+
+#include <BinaryFile.hpp>
+#include <TextWriter.hpp>
+#include <Parser.hpp>
+#include <Exception.hpp>
+
+#define BINARY_MAGIC   "GAIABIN"
+#define BINARY_VERSION 1
+
+// values are converted and written through a buffer of this many bytes
+#define BINARY_BLOCK   (1 << 20)
+
+namespace Gaia {
+
+static_assert(sizeof(BinaryFile::Header) == 128,
+	"BinaryFile::Header must be exactly 128 bytes!");
+
+void BinaryFile::Swap(void *data, const std::size_t size,
+	const std::size_t n){
+
+	unsigned char *bytes = (unsigned char*) data;
+
+	for (std::size_t i = 0; i < n; i++, bytes += size)
+	for (std::size_t j = 0; j < size / 2; j++)
+		std::swap(bytes[j], bytes[size - 1 - j]);
+}
+
+void BinaryFile::Swap(Header &header){
+
+	Swap(&header.version, 4, 1);
+	Swap(&header.dtype,   4, 1);
+	Swap(&header.rows,    8, 1);
+	Swap(&header.columns, 4, 1);
+	Swap(&header.trial,   4, 1);
+	Swap(&header.seed,    8, 1);
+	Swap( header.limits,  8, 6);
+	Swap( header.shape,   8, 3);
+}
+
+bool BinaryFile::LittleEndian(){
+
+	const std::uint32_t one = 1;
+	return *(const unsigned char*) &one == 1;
+}
+
+BinaryFile::Header BinaryFile::NewHeader(const std::string &kind,
+	const std::size_t rows, const std::size_t columns, const std::size_t trial,
+	const std::size_t dtype){
+
+	Parser *parser = Parser::GetInstance();
+	std::vector<double> X = parser -> GetXlimits();
+	std::vector<double> Y = parser -> GetYlimits();
+	std::vector<double> Z = parser -> GetZlimits();
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	std::strncpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+	std::strncpy(header.kind, kind.c_str(), sizeof(header.kind) - 1);
+
+	header.version = BINARY_VERSION;
+	header.dtype   = dtype;
+	header.rows    = rows;
+	header.columns = columns;
+	header.trial   = trial;
+	header.seed    = parser -> GetFirstSeed();
+
+	double limits[6] = { X[0], X[1], Y[0], Y[1], Z[0], Z[1] };
+	std::memcpy(header.limits, limits, sizeof(limits));
+
+	return header;
+}
+
+std::uint64_t BinaryFile::Bytes(const Header &header){
+
+	return sizeof(Header) + header.rows * header.columns * header.dtype;
+}
+
+void BinaryFile::Write(const std::string &filename, const Header &header,
+	const std::vector<const double*> &columns){
+
+	FILE *output = std::fopen(filename.c_str(), "wb");
+
+	if ( !output ) throw IOError("From BinaryFile::Write(), I couldn't "
+		"open the file `" + filename + "`!");
+
+	try { Write(output, filename, header, columns); }
+	catch (...) { std::fclose(output); throw; }
+
+	if ( std::fclose(output) )
+		throw IOError("From BinaryFile::Write(), I failed writing to `" +
+		filename + "`!");
+}
+
+std::uint64_t BinaryFile::Write(FILE *output, const std::string &name,
+	const Header &header, const std::vector<const double*> &columns){
+
+	if ( columns.size() != header.columns )
+		throw IOError("From BinaryFile::Write(), the number of columns does "
+		"not match the header for `" + name + "`!");
+
+	if ( header.dtype != 4 && header.dtype != 8 )
+		throw IOError("From BinaryFile::Write(), unsupported data type for `"
+		+ name + "`!");
+
+	bool swap = !LittleEndian();
+	Header stored = header;
+	if ( swap ) Swap(stored);
+
+	bool good = std::fwrite(&stored, sizeof(Header), 1, output) == 1;
+
+	// convert (and swap) each column in blocks
+	std::vector<unsigned char> block(BINARY_BLOCK);
+	std::size_t per_block = BINARY_BLOCK / header.dtype;
+
+	for ( const auto& column : columns )
+	for ( std::size_t i = 0; good && i < header.rows; i += per_block ){
+
+		std::size_t n = std::min(per_block, std::size_t(header.rows - i));
+
+		if ( header.dtype == 8 )
+			std::memcpy(block.data(), column + i, n * 8);
+
+		else {
+
+			float *values = (float*) block.data();
+			for ( std::size_t j = 0; j < n; j++ )
+				values[j] = column[i + j];
+		}
+
+		if ( swap ) Swap(block.data(), header.dtype, n);
+
+		good = std::fwrite(block.data(), header.dtype, n, output) == n;
+	}
+
+	if ( !good ) throw IOError("From BinaryFile::Write(), I failed writing "
+		"to `" + name + "`!");
+
+	return Bytes(header);
+}
+
+BinaryFile::Header BinaryFile::Read(const std::string &filename,
+	std::vector< std::vector<double> > &columns){
+
+	FILE *input = std::fopen(filename.c_str(), "rb");
+
+	if ( !input ) throw IOError("From BinaryFile::Read(), I couldn't "
+		"open the file `" + filename + "`!");
+
+	Header header;
+
+	try { header = Read(input, filename, columns); }
+	catch (...) { std::fclose(input); throw; }
+
+	std::fclose(input);
+	return header;
+}
+
+BinaryFile::Header BinaryFile::Read(FILE *input, const std::string &name,
+	std::vector< std::vector<double> > &columns){
+
+	Header header;
+	bool swap = !LittleEndian();
+
+	if ( std::fread(&header, sizeof(Header), 1, input) != 1 ||
+		std::strncmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) )
+		throw IOError("From BinaryFile::Read(), `" + name + "` is not "
+		"a Gaia binary file!");
+
+	if ( swap ) Swap(header);
+
+	if ( header.version != BINARY_VERSION ||
+		(header.dtype != 4 && header.dtype != 8) )
+		throw IOError("From BinaryFile::Read(), `" + name + "` has an "
+		"unsupported version or data type!");
+
+	columns.assign(header.columns, std::vector<double>(header.rows));
+	std::vector<float> single(header.dtype == 4 ? header.rows : 0);
+
+	bool good = true;
+
+	for ( auto& column : columns ){
+
+		if ( header.dtype == 8 ){
+
+			good = good && std::fread(column.data(), 8, header.rows, input) ==
+				header.rows;
+
+			if ( swap ) Swap(column.data(), 8, header.rows);
+
+		} else {
+
+			good = good && std::fread(single.data(), 4, header.rows, input) ==
+				header.rows;
+
+			if ( swap ) Swap(single.data(), 4, header.rows);
+
+			for ( std::size_t i = 0; i < header.rows; i++ )
+				column[i] = single[i];
+		}
+	}
+
+	if ( !good ) throw IOError("From BinaryFile::Read(), `" + name +
+		"` is truncated!");
+
+	return header;
+}
+
+void BinaryFile::Convert(const std::string &input, const std::string &output){
+
+	//
+	// Export a binary file as text in the same layout Gaia uses for its
+	// text output (one row per line).
+	//
+
+	std::vector< std::vector<double> > columns;
+	Header header = Read(input, columns);
+
+	std::vector<const double*> pointers;
+	for ( const auto& column : columns )
+		pointers.push_back( column.data() );
+
+	TextWriter::Write(output, pointers, header.rows);
+}
+
+} // namespace Gaia
@@ -0,0 +1,396 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/BucketFile.cc
+//
+// Source file for the `BucketFile` class. See Include/BucketFile.hpp.
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <omp.h>
+
+#include <BucketFile.hpp>
+#include <Vector.hpp>
+#include <Exception.hpp>
+
+// the cache holds about this many buckets
+#define BUCKET_CACHE 64
+
+// limits on the number of records in a bucket
+#define BUCKET_MIN   1024
+#define BUCKET_MAX   (1 << 20)
+
+namespace Gaia {
+
+BucketFile::BucketFile(const std::string &filename, const std::vector<double> &X,
+	const std::vector<double> &Y, const std::vector<double> &Z,
+	const std::size_t N, const std::size_t cache){
+
+	_filename  = filename;
+	_max_bytes = cache;
+	_length    = 0;
+	_clock     = 0;
+	_bytes     = 0;
+
+	_file = std::fopen(filename.c_str(), "w+b");
+
+	if ( !_file ) throw IOError("From BucketFile::BucketFile(), I couldn't "
+		"open the scratch file `" + filename + "`!");
+
+	const std::vector<double> *limits[3] = { &X, &Y, &Z };
+	double span[3];
+
+	for ( int d = 0; d < 3; d++ ){
+
+		_origin[d] = (*limits[d])[0];
+		span[d]    = (*limits[d])[1] - (*limits[d])[0];
+		_cells[d]  = 0;
+	}
+
+	//
+	// Cells are about cubic. A direction that is thinner than a cell (a disk
+	// in Z for instance) gets a single cell and the rest are divided again.
+	//
+
+	double buckets = std::max(1.0, double(N) / double(BucketSize(cache)));
+
+	for ( int pass = 0; pass < 3; pass++ ){
+
+		double volume = 1.0;
+		int free = 0;
+
+		for ( int d = 0; d < 3; d++ )
+			if ( !_cells[d] ){ volume *= span[d]; free++; }
+
+		if ( !free ) break;
+
+		double side = std::pow(volume / buckets, 1.0 / free);
+		bool fixed = false;
+
+		for ( int d = 0; d < 3; d++ )
+			if ( !_cells[d] && span[d] < side ){ _cells[d] = 1; fixed = true; }
+
+		if ( fixed ) continue;
+
+		for ( int d = 0; d < 3; d++ )
+			if ( !_cells[d] ) _cells[d] = std::min(1L << 20,
+				(long) std::ceil(span[d] / side));
+	}
+
+	for ( int d = 0; d < 3; d++ ){
+
+		_cells[d] = std::max(1L, _cells[d]);
+		_width[d] = span[d] / _cells[d];
+	}
+
+	// distances to cell walls are made smaller by this to allow for rounding
+	_slack = 1e-9 * std::min(_width[0], std::min(_width[1], _width[2]));
+
+	_runs.resize(_cells[0] * _cells[1] * _cells[2]);
+	_count.resize(_runs.size(), 0);
+}
+
+BucketFile::~BucketFile(){
+
+	if ( _file ) std::fclose(_file);
+	std::remove(_filename.c_str());
+}
+
+std::size_t BucketFile::BucketSize(const std::size_t cache){
+
+	std::size_t records = cache / sizeof(Record) / BUCKET_CACHE;
+	return std::min<std::size_t>(BUCKET_MAX, std::max<std::size_t>(BUCKET_MIN,
+		records));
+}
+
+void BucketFile::Reset(){
+
+	_length = 0;
+	_bytes  = 0;
+	_cache.clear();
+
+	for ( auto& runs : _runs ) runs.clear();
+	std::fill(_count.begin(), _count.end(), 0);
+}
+
+std::size_t BucketFile::Index(const long a, const long b, const long c) const {
+
+	return (a * _cells[1] + b) * _cells[2] + c;
+}
+
+std::size_t BucketFile::Locate(const double x, const double y,
+	const double z) const {
+
+	const double point[3] = { x, y, z };
+	long cell[3];
+
+	for ( int d = 0; d < 3; d++ ){
+
+		cell[d] = (long) std::floor((point[d] - _origin[d]) / _width[d]);
+		cell[d] = std::min(_cells[d] - 1, std::max(0L, cell[d]));
+	}
+
+	return Index(cell[0], cell[1], cell[2]);
+}
+
+double BucketFile::Distance(const Vector &point, const long a, const long b,
+	const long c) const {
+
+	const double q[3] = { point.X(), point.Y(), point.Z() };
+	const long cell[3] = { a, b, c };
+	double sum = 0.0;
+
+	for ( int d = 0; d < 3; d++ ){
+
+		double lower = _origin[d] + cell[d] * _width[d];
+		double upper = lower + _width[d];
+		double gap   = std::max(0.0, std::max(lower - q[d], q[d] - upper));
+
+		sum += gap * gap;
+	}
+
+	return std::sqrt(sum) - _slack;
+}
+
+void BucketFile::Append(std::vector<Record> &batch){
+
+	//
+	// Counting sort of the batch by bucket, then one write. Each bucket
+	// with records in this batch gets a new run.
+	//
+
+	std::vector<std::uint64_t> start(_runs.size() + 1, 0);
+	std::vector<std::size_t> bucket(batch.size());
+
+	for ( std::size_t i = 0; i < batch.size(); i++ ){
+
+		bucket[i] = Locate(batch[i].x, batch[i].y, batch[i].z);
+		start[bucket[i] + 1]++;
+	}
+
+	for ( std::size_t b = 0; b < _runs.size(); b++ )
+		start[b + 1] += start[b];
+
+	std::vector<Record> sorted(batch.size());
+	std::vector<std::uint64_t> next(start.begin(), start.end() - 1);
+
+	for ( std::size_t i = 0; i < batch.size(); i++ )
+		sorted[ next[bucket[i]]++ ] = batch[i];
+
+	fseeko(_file, (off_t) (_length * sizeof(Record)), SEEK_SET);
+
+	if ( std::fwrite(sorted.data(), sizeof(Record), sorted.size(), _file) !=
+		sorted.size() ) throw IOError("From BucketFile::Append(), I failed "
+		"writing to the scratch file `" + _filename + "`!");
+
+	for ( std::size_t b = 0; b < _runs.size(); b++ )
+	if ( start[b + 1] > start[b] ){
+
+		_runs[b].push_back( std::make_pair(_length + start[b],
+			start[b + 1] - start[b]) );
+		_count[b] += start[b + 1] - start[b];
+	}
+
+	_length += sorted.size();
+	batch.swap(sorted);
+}
+
+const std::vector<BucketFile::Record>& BucketFile::Load(
+	const std::size_t bucket, const std::size_t keep){
+
+	auto found = _cache.find(bucket);
+
+	if ( found != _cache.end() ){
+
+		found -> second.second = ++_clock;
+		return found -> second.first;
+	}
+
+	std::size_t bytes = _count[bucket] * sizeof(Record);
+
+	// evict the least recently used buckets (a single bucket larger than
+	// the whole cache is still loaded)
+	while ( !_cache.empty() && _bytes + bytes > _max_bytes ){
+
+		auto victim = _cache.end();
+
+		for ( auto it = _cache.begin(); it != _cache.end(); ++it )
+			if ( it -> first != keep && ( victim == _cache.end() ||
+				it -> second.second < victim -> second.second ) ) victim = it;
+
+		if ( victim == _cache.end() ) break;
+
+		_bytes -= victim -> second.first.size() * sizeof(Record);
+		_cache.erase(victim);
+	}
+
+	std::vector<Record> records(_count[bucket]);
+	std::size_t filled = 0;
+
+	for ( const auto& run : _runs[bucket] ){
+
+		fseeko(_file, (off_t) (run.first * sizeof(Record)), SEEK_SET);
+
+		if ( std::fread(&records[filled], sizeof(Record), run.second, _file)
+			!= run.second ) throw IOError("From BucketFile::Load(), I failed "
+			"reading the scratch file `" + _filename + "`!");
+
+		filled += run.second;
+	}
+
+	// sorted along x so a search can stop early
+	std::sort(records.begin(), records.end(),
+		[](const Record &a, const Record &b){ return a.x < b.x; });
+
+	_bytes += bytes;
+	auto &entry = _cache[bucket];
+	entry.first.swap(records);
+	entry.second = ++_clock;
+
+	return entry.first;
+}
+
+void BucketFile::Search(const std::vector<Record> &bucket,
+	const PositionArray &samples, const std::vector<std::size_t> &members,
+	std::vector<double> &best){
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for ( std::size_t m = 0; m < members.size(); m++ ){
+
+		std::size_t s = members[m];
+		Vector query  = samples[s];
+		double radius = best[s];
+
+		auto first = std::lower_bound(bucket.begin(), bucket.end(), query.X(),
+			[](const Record &a, const double x){ return a.x < x; });
+
+		// walk away from the query in x until no closer point is possible
+		for ( auto j = first; j != bucket.end() && j -> x - query.X() < radius;
+			++j ) if ( j -> id != s ){
+
+			double r = (query - Vector(j -> x, j -> y, j -> z)).Mag();
+			if ( r < radius ) radius = r;
+		}
+
+		for ( auto j = first; j != bucket.begin() &&
+			query.X() - (j - 1) -> x < radius; ){
+
+			--j;
+			if ( j -> id == s ) continue;
+
+			double r = (query - Vector(j -> x, j -> y, j -> z)).Mag();
+			if ( r < radius ) radius = r;
+		}
+
+		best[s] = radius;
+	}
+}
+
+void BucketFile::Nearest(const PositionArray &samples,
+	std::vector<double> &best){
+
+	//
+	// Samples are grouped by their (home) bucket. The home bucket is
+	// searched first, then shells of buckets at Chebyshev distance k = 1, 2,
+	// ... around it. A shell is only visited while some sample's current
+	// best is farther than the cells already covered, and a bucket in the
+	// shell only if it is closer to a sample than that sample's best.
+	//
+
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	std::vector<std::size_t> home(samples.size()), order(samples.size());
+
+	for ( std::size_t i = 0; i < samples.size(); i++ ){
+
+		home[i]  = Locate(samples[i].X(), samples[i].Y(), samples[i].Z());
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+		[&home](std::size_t a, std::size_t b){ return home[a] < home[b]; });
+
+	long largest = std::max(_cells[0], std::max(_cells[1], _cells[2]));
+	std::vector<std::size_t> members, active, subset;
+
+	for ( std::size_t first = 0, last = 0; first < order.size(); first = last ){
+
+		std::size_t h = home[ order[first] ];
+
+		for ( last = first; last < order.size() && home[order[last]] == h; )
+			last++;
+
+		members.assign(order.begin() + first, order.begin() + last);
+
+		// cell of the home bucket
+		const long center[3] = { long(h / _cells[2] / _cells[1]),
+			long(h / _cells[2] % _cells[1]), long(h % _cells[2]) };
+
+		if ( _count[h] ) Search(Load(h, h), samples, members, best);
+
+		for ( long k = 1; k <= largest; k++ ){
+
+			// samples that could have a closer neighbor outside radius k - 1
+			active.clear();
+
+			for ( const auto& s : members ){
+
+				const double q[3] = { samples[s].X(), samples[s].Y(),
+					samples[s].Z() };
+				double bound = infinity;
+
+				for ( int d = 0; d < 3; d++ ){
+
+					long lower = center[d] - (k - 1);
+					long upper = center[d] + (k - 1);
+
+					if ( lower > 0 ) bound = std::min(bound,
+						q[d] - (_origin[d] + lower * _width[d]));
+
+					if ( upper < _cells[d] - 1 ) bound = std::min(bound,
+						_origin[d] + (upper + 1) * _width[d] - q[d]);
+				}
+
+				if ( best[s] > bound - _slack ) active.push_back(s);
+			}
+
+			if ( active.empty() ) break;
+
+			// the buckets of shell k
+			for ( long a = std::max(0L, center[0] - k);
+				a <= std::min(_cells[0] - 1, center[0] + k); a++ )
+			for ( long b = std::max(0L, center[1] - k);
+				b <= std::min(_cells[1] - 1, center[1] + k); b++ )
+			for ( long c = std::max(0L, center[2] - k);
+				c <= std::min(_cells[2] - 1, center[2] + k); c++ ){
+
+				bool wall = std::abs(a - center[0]) == k ||
+					std::abs(b - center[1]) == k;
+
+				// interior of the shell, skip to its far side
+				if ( !wall && std::abs(c - center[2]) != k ){
+
+					c = center[2] + k - 1;
+					continue;
+				}
+
+				std::size_t index = Index(a, b, c);
+				if ( !_count[index] ) continue;
+
+				subset.clear();
+				for ( const auto& s : active )
+					if ( best[s] > Distance(samples[s], a, b, c) )
+						subset.push_back(s);
+
+				if ( !subset.empty() )
+					Search(Load(index, h), samples, subset, best);
+			}
+		}
+	}
+}
+
+} // namespace Gaia
@@ -0,0 +1,152 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/Checkpoint.cc
+//
+// Source file for the `Checkpoint` class. See Include/Checkpoint.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <Checkpoint.hpp>
+#include <BinaryFile.hpp>
+#include <Exception.hpp>
+
+#define CHECKPOINT_MAGIC   "GAIACHK"
+#define CHECKPOINT_VERSION 1
+
+namespace Gaia {
+
+static_assert(sizeof(Checkpoint::Header) == 64,
+	"Checkpoint::Header must be exactly 64 bytes!");
+
+namespace {
+
+// numbers are stored little-endian
+void Swap(Checkpoint::Header &header){
+
+	BinaryFile::Swap(&header.version,   4, 1);
+	BinaryFile::Swap(&header.completed, 4, 1);
+	BinaryFile::Swap(&header.signature, 8, 1);
+	BinaryFile::Swap(&header.pooled,    8, 1);
+	BinaryFile::Swap(&header.rng,       8, 1);
+	BinaryFile::Swap(&header.squares,   8, 1);
+}
+
+// write `n` values of `size` bytes in little-endian order
+bool Put(FILE *output, const void *data, const std::size_t size,
+	const std::size_t n){
+
+	if ( !n ) return true;
+	if ( BinaryFile::LittleEndian() )
+		return std::fwrite(data, size, n, output) == n;
+
+	std::vector<unsigned char> copy((const unsigned char*) data,
+		(const unsigned char*) data + size * n);
+	BinaryFile::Swap(copy.data(), size, n);
+
+	return std::fwrite(copy.data(), size, n, output) == n;
+}
+
+bool Get(FILE *input, void *data, const std::size_t size, const std::size_t n){
+
+	if ( !n ) return true;
+	if ( std::fread(data, size, n, input) != n ) return false;
+	if ( !BinaryFile::LittleEndian() ) BinaryFile::Swap(data, size, n);
+
+	return true;
+}
+
+} // anonymous namespace
+
+void Checkpoint::Save(const std::string &filename, const State &state){
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	std::strncpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version   = CHECKPOINT_VERSION;
+	header.completed = state.completed;
+	header.signature = state.signature;
+	header.pooled    = state.mean.size();
+	header.rng       = state.rng.size();
+	header.squares   = state.squares.size();
+
+	if ( !BinaryFile::LittleEndian() ) Swap(header);
+
+	std::stringstream buffer;
+	buffer << filename << ".tmp" << getpid();
+	std::string temp = buffer.str();
+
+	FILE *output = std::fopen(temp.c_str(), "wb");
+
+	if ( !output ) throw IOError("From Checkpoint::Save(), I couldn't open "
+		"the file `" + temp + "`!");
+
+	bool good = std::fwrite(&header, sizeof(Header), 1, output) == 1;
+	good = good && Put(output, state.mean.data(), 8, state.mean.size());
+	good = good && Put(output, state.variance.data(), 8, state.variance.size());
+	good = good && Put(output, state.rng.data(), 8, state.rng.size());
+	good = good && Put(output, state.squares.data(), 8, state.squares.size());
+	good = !std::fclose(output) && good;
+
+	// a preempted job never leaves a partial checkpoint behind
+	if ( !good || std::rename(temp.c_str(), filename.c_str()) ){
+
+		std::remove(temp.c_str());
+		throw IOError("From Checkpoint::Save(), I failed writing to `" +
+			filename + "`!");
+	}
+}
+
+void Checkpoint::Load(const std::string &filename, State &state){
+
+	FILE *input = std::fopen(filename.c_str(), "rb");
+
+	if ( !input ) throw IOError("From Checkpoint::Load(), I couldn't open "
+		"the checkpoint `" + filename + "`!");
+
+	Header header;
+	bool good = std::fread(&header, sizeof(Header), 1, input) == 1 &&
+		!std::strncmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+	if ( good && !BinaryFile::LittleEndian() ) Swap(header);
+	good = good && header.version == CHECKPOINT_VERSION;
+
+	if ( good ){
+
+		state.completed = header.completed;
+		state.signature = header.signature;
+		state.mean.resize(header.pooled);
+		state.variance.resize(header.pooled);
+		state.rng.resize(header.rng);
+		state.squares.resize(header.squares);
+
+		good = Get(input, state.mean.data(), 8, header.pooled) &&
+			Get(input, state.variance.data(), 8, header.pooled) &&
+			Get(input, state.rng.data(), 8, header.rng) &&
+			Get(input, state.squares.data(), 8, header.squares);
+	}
+
+	std::fclose(input);
+
+	if ( !good ) throw IOError("From Checkpoint::Load(), `" + filename +
+		"` is not a (complete) Gaia checkpoint!");
+}
+
+std::uint64_t Checkpoint::Signature(const std::string &configuration){
+
+	std::uint64_t hash = 14695981039346656037ULL;
+
+	for ( const auto& c : configuration ){
+
+		hash ^= (unsigned char) c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+} // namespace Gaia
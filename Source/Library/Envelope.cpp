@@ -0,0 +1,171 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/Envelope.cc
+//
+// Source file for the `Envelope` class. See Include/Envelope.hpp.
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include <Envelope.hpp>
+#include <Exception.hpp>
+
+// the largest value found in a cell is raised by this fraction
+#define ENVELOPE_MARGIN 0.25
+
+// points per side of a cell where the profiles are evaluated
+#define ENVELOPE_PROBES 3
+
+#ifndef pi
+#define pi 3.141592653589793
+#endif
+
+namespace Gaia {
+
+Envelope::Envelope(const std::vector<ProfileBase*> &profiles,
+	const std::vector<double> &X, const std::vector<double> &Y,
+	const std::vector<double> &Z, const ChainBase *chain): _profiles(profiles),
+	_chain(chain), _exceeded(0) {
+
+	// nearest and farthest distance of the `box` from the Z axis
+	double near_X = X[0] <= 0.0 && X[1] >= 0.0 ? 0.0 :
+		std::min(std::abs(X[0]), std::abs(X[1]));
+	double near_Y = Y[0] <= 0.0 && Y[1] >= 0.0 ? 0.0 :
+		std::min(std::abs(Y[0]), std::abs(Y[1]));
+	double far_X  = std::max(std::abs(X[0]), std::abs(X[1]));
+	double far_Y  = std::max(std::abs(Y[0]), std::abs(Y[1]));
+
+	double R_min = std::sqrt(near_X * near_X + near_Y * near_Y);
+	double R_max = std::sqrt(far_X * far_X + far_Y * far_Y);
+
+	_R.resize(ENVELOPE_R + 1);
+	_Z.resize(ENVELOPE_Z + 1);
+
+	for ( std::size_t i = 0; i <= ENVELOPE_R; i++ )
+		_R[i] = R_min + (R_max - R_min) * i / ENVELOPE_R;
+
+	for ( std::size_t j = 0; j <= ENVELOPE_Z; j++ )
+		_Z[j] = Z[0] + (Z[1] - Z[0]) * j / ENVELOPE_Z;
+
+	_bound.resize(ENVELOPE_R * ENVELOPE_Z);
+	_short.assign(_bound.size(), 0.0);
+
+	_mass = 0.0;
+
+	for ( std::size_t i = 0; i < ENVELOPE_R; i++ )
+	for ( std::size_t j = 0; j < ENVELOPE_Z; j++ ){
+
+		double largest = 0.0;
+
+		// the profiles only depend on R and Z, so Phi = 0 will do
+		for ( int a = 0; a < ENVELOPE_PROBES; a++ )
+		for ( int b = 0; b < ENVELOPE_PROBES; b++ ){
+
+			double R = _R[i] + (_R[i + 1] - _R[i]) * a / (ENVELOPE_PROBES - 1);
+			double z = _Z[j] + (_Z[j + 1] - _Z[j]) * b / (ENVELOPE_PROBES - 1);
+
+			largest = std::max(largest, Evaluate( Vector(R, 0.0, z) ));
+		}
+
+		// volume of the ring (without the factor of pi)
+		double volume = (_R[i + 1] * _R[i + 1] - _R[i] * _R[i]) *
+			(_Z[j + 1] - _Z[j]);
+
+		_bound[i * ENVELOPE_Z + j] = largest * (1.0 + ENVELOPE_MARGIN);
+
+		_mass += volume * Evaluate( Vector(0.5 * (_R[i] + _R[i + 1]), 0.0,
+			0.5 * (_Z[j] + _Z[j + 1])) );
+	}
+
+	Accumulate();
+}
+
+void Envelope::Accumulate(){
+
+	_cumulative.resize(_bound.size());
+
+	double total = 0.0;
+
+	for ( std::size_t i = 0; i < ENVELOPE_R; i++ )
+	for ( std::size_t j = 0; j < ENVELOPE_Z; j++ ){
+
+		double volume = (_R[i + 1] * _R[i + 1] - _R[i] * _R[i]) *
+			(_Z[j + 1] - _Z[j]);
+
+		total += _bound[i * ENVELOPE_Z + j] * volume;
+		_cumulative[i * ENVELOPE_Z + j] = total;
+	}
+
+	if ( !(total > 0.0) ) throw ProfileError("From Envelope::Envelope(), "
+		"the profiles vanish everywhere in the `box`!");
+
+	for ( auto& weight : _cumulative )
+		weight /= total;
+
+	_efficiency = _mass / total;
+}
+
+void Envelope::Exceeded(const std::size_t cell, const double product){
+
+	std::lock_guard<std::mutex> guard(_lock);
+
+	_short[cell] = std::max(_short[cell], product);
+	_exceeded++;
+}
+
+std::size_t Envelope::Raise(){
+
+	if ( !_exceeded ) return 0;
+
+	for ( std::size_t cell = 0; cell < _bound.size(); cell++ ){
+
+		_bound[cell] = std::max(_bound[cell], _short[cell] *
+			(1.0 + ENVELOPE_MARGIN));
+		_short[cell] = 0.0;
+	}
+
+	Accumulate();
+
+	std::size_t exceeded = _exceeded;
+	_exceeded = 0;
+
+	return exceeded;
+}
+
+Vector Envelope::Sample(ParallelMT *source, const int thread,
+	double &bound, std::size_t &cell) const {
+
+	// a cell from the cumulative distribution
+	cell = std::lower_bound(_cumulative.begin(),
+		_cumulative.end(), source -> RandomReal(thread)) - _cumulative.begin();
+	cell = std::min(cell, _cumulative.size() - 1);
+
+	std::size_t i = cell / ENVELOPE_Z, j = cell % ENVELOPE_Z;
+
+	// uniform in the volume of the ring (the Jacobian is R)
+	double inner = _R[i] * _R[i], outer = _R[i + 1] * _R[i + 1];
+	double R   = std::sqrt(inner + (outer - inner) * source ->
+		RandomReal(thread));
+	double z   = _Z[j] + (_Z[j + 1] - _Z[j]) * source -> RandomReal(thread);
+	double phi = 2.0 * pi * source -> RandomReal(thread);
+
+	bound = _bound[cell];
+
+	return Vector(R * std::cos(phi), R * std::sin(phi), z);
+}
+
+double Envelope::Evaluate(const Vector &position) const {
+
+	Point point(position);
+	if ( _chain ) return _chain -> Product(point);
+
+	double product = 1.0;
+
+	for ( const auto& pdf : _profiles )
+		product *= ProfileBase::Keep( pdf -> Evaluate(point) );
+
+	return product;
+}
+
+} // namespace Gaia
@@ -0,0 +1,482 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/Expression.cc
+//
+// Source file for the `Expression` class. See Include/Expression.hpp.
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Expression.hpp>
+#include <Exception.hpp>
+#include <Vector.hpp>
+
+// every instruction of the batched form is a loop over the block
+#define BLOCK(statement) \
+	_Pragma("omp simd") \
+	for ( std::size_t i = 0; i < m; i++ ) statement; \
+	break
+
+namespace Gaia {
+
+namespace {
+
+// functions of one and of two arguments by name
+const std::map<std::string, Expression::Operation> Unaries = {
+	{"exp", Expression::EXP}, {"log", Expression::LOG},
+	{"log10", Expression::LOG10}, {"sqrt", Expression::SQRT},
+	{"abs", Expression::ABS}, {"sin", Expression::SIN},
+	{"cos", Expression::COS}, {"tan", Expression::TAN},
+	{"asin", Expression::ASIN}, {"acos", Expression::ACOS},
+	{"atan", Expression::ATAN}, {"sinh", Expression::SINH},
+	{"cosh", Expression::COSH}, {"tanh", Expression::TANH},
+	{"floor", Expression::FLOOR}, {"ceil", Expression::CEIL}
+};
+
+const std::map<std::string, Expression::Operation> Binaries = {
+	{"atan2", Expression::ATAN2}, {"pow", Expression::POWER},
+	{"min", Expression::MIN}, {"max", Expression::MAX}
+};
+
+const std::map<std::string, Expression::Operation> Coordinates = {
+	{"X", Expression::X}, {"Y", Expression::Y}, {"Z", Expression::Z},
+	{"R", Expression::R}, {"Rho", Expression::RHO},
+	{"Phi", Expression::PHI}, {"Theta", Expression::THETA}
+};
+
+bool Loads(const Expression::Operation op){
+	return op >= Expression::X && op <= Expression::THETA;
+}
+
+bool TakesTwo(const Expression::Operation op){
+	return ( op >= Expression::ADD && op <= Expression::POWER ) ||
+		op >= Expression::ATAN2;
+}
+
+} // anonymous namespace
+
+Expression::Expression(const std::string &name, const std::string &text):
+	_name(name), _text(text), _position(0) {
+
+	std::fill(_uses, _uses + THETA + 1, false);
+
+	std::size_t root = Sum();
+
+	Skip();
+	if ( _position < _text.size() )
+		Fail(std::string("unexpected `") + _text[_position] + "`");
+
+	Emit(root);
+}
+
+void Expression::Skip(){
+
+	while ( _position < _text.size() && std::isspace(_text[_position]) )
+		_position++;
+}
+
+bool Expression::Accept(const char c){
+
+	Skip();
+	if ( _position < _text.size() && _text[_position] == c ){
+
+		_position++;
+		return true;
+	}
+
+	return false;
+}
+
+void Expression::Expect(const char c){
+
+	if ( !Accept(c) ) Fail(std::string("expected `") + c + "`");
+}
+
+void Expression::Fail(const std::string &what) const {
+
+	std::stringstream warning;
+	warning << "In the definition of `" << _name << "`, " << what << " at "
+		<< "character " << std::min(_position, _text.size()) + 1 << " of \""
+		<< _text << "\"!";
+
+	throw ProfileError( warning.str() );
+}
+
+// sum := product (('+' | '-') product)*
+std::size_t Expression::Sum(){
+
+	std::size_t node = Product();
+
+	while ( true ){
+
+		if      ( Accept('+') ) node = Make(ADD, node, Product());
+		else if ( Accept('-') ) node = Make(SUBTRACT, node, Product());
+		else return node;
+	}
+}
+
+// product := unary (('*' | '/') unary)*
+std::size_t Expression::Product(){
+
+	std::size_t node = Unary();
+
+	while ( true ){
+
+		if      ( Accept('*') ) node = Make(MULTIPLY, node, Unary());
+		else if ( Accept('/') ) node = Make(DIVIDE, node, Unary());
+		else return node;
+	}
+}
+
+// unary := ('-' | '+') unary | power
+std::size_t Expression::Unary(){
+
+	if ( Accept('-') ) return Make(NEGATE, Unary());
+	if ( Accept('+') ) return Unary();
+
+	return Power();
+}
+
+// power := primary ('^' unary)?, so -x^2 is -(x^2) and 2^-1 is allowed
+std::size_t Expression::Power(){
+
+	std::size_t node = Primary();
+
+	if ( Accept('^') ) node = Make(POWER, node, Unary());
+
+	return node;
+}
+
+// primary := number | coordinate | constant | function '(' sum ')' |
+//            function '(' sum ',' sum ')' | '(' sum ')'
+std::size_t Expression::Primary(){
+
+	Skip();
+	if ( _position >= _text.size() ) Fail("the expression ended early");
+
+	if ( Accept('(') ){
+
+		std::size_t node = Sum();
+		Expect(')');
+		return node;
+	}
+
+	const char *start = _text.c_str() + _position;
+
+	if ( std::isdigit(*start) || ( *start == '.' &&
+		std::isdigit(start[1]) ) ){
+
+		char *end;
+		double value = std::strtod(start, &end);
+		_position += end - start;
+		return Constant(value);
+	}
+
+	if ( !std::isalpha(*start) && *start != '_' )
+		Fail(std::string("unexpected `") + *start + "`");
+
+	std::size_t first = _position;
+	while ( _position < _text.size() && ( std::isalnum(_text[_position]) ||
+		_text[_position] == '_' ) ) _position++;
+
+	std::string word = _text.substr(first, _position - first);
+
+	if ( Coordinates.count(word) ) return Make(Coordinates.at(word));
+	if ( word == "pi" ) return Constant(3.141592653589793);
+	if ( word == "e"  ) return Constant(2.718281828459045);
+
+	if ( Unaries.count(word) ){
+
+		Expect('(');
+		std::size_t node = Sum();
+		Expect(')');
+		return Make(Unaries.at(word), node);
+	}
+
+	if ( Binaries.count(word) ){
+
+		Expect('(');
+		std::size_t a = Sum();
+		Expect(',');
+		std::size_t b = Sum();
+		Expect(')');
+		return Make(Binaries.at(word), a, b);
+	}
+
+	_position = first;
+	Fail("`" + word + "` is not a coordinate, constant or function");
+	return 0;
+}
+
+std::size_t Expression::Constant(const double value){
+
+	auto found = _constants.find(value);
+	if ( found != _constants.end() ) return found -> second;
+
+	_nodes.push_back( Node{CONSTANT, 0, 0, value} );
+	return _constants[value] = _nodes.size() - 1;
+}
+
+std::size_t Expression::Make(const Operation op, std::size_t a,
+	std::size_t b){
+
+	if ( Loads(op) ) a = b = 0;
+	if ( !TakesTwo(op) ) b = 0;
+
+	bool constant_a = !Loads(op) && _nodes[a].op == CONSTANT;
+	bool constant_b = TakesTwo(op) && _nodes[b].op == CONSTANT;
+	double value_a  = constant_a ? _nodes[a].value : 0.0;
+	double value_b  = constant_b ? _nodes[b].value : 0.0;
+
+	// fold constants
+	if ( constant_a && ( constant_b || !TakesTwo(op) ) )
+		return Constant( Apply(op, value_a, value_b) );
+
+	// the identities that hold for every value
+	switch ( op ){
+
+		case ADD:
+			if ( constant_a && value_a == 0.0 ) return b;
+			if ( constant_b && value_b == 0.0 ) return a;
+			break;
+
+		case SUBTRACT:
+			if ( constant_b && value_b == 0.0 ) return a;
+			if ( constant_a && value_a == 0.0 ) return Make(NEGATE, b);
+			break;
+
+		case MULTIPLY:
+			if ( constant_a && value_a == 1.0 ) return b;
+			if ( constant_b && value_b == 1.0 ) return a;
+			break;
+
+		case DIVIDE:
+			if ( constant_b && value_b == 1.0 ) return a;
+			break;
+
+		case POWER:
+			if ( constant_b && value_b == 0.0 ) return Constant(1.0);
+			if ( constant_b && value_b == 1.0 ) return a;
+			if ( constant_b && value_b == 2.0 ) return Make(SQUARE, a);
+			break;
+
+		case NEGATE:
+			if ( _nodes[a].op == NEGATE ) return _nodes[a].a;
+			break;
+
+		default: break;
+	}
+
+	// the order of the operands doesn't matter for these
+	if ( ( op == ADD || op == MULTIPLY || op == MIN || op == MAX ) && b < a )
+		std::swap(a, b);
+
+	auto key = std::make_tuple(int(op), a, b);
+	auto found = _shared.find(key);
+	if ( found != _shared.end() ) return found -> second;
+
+	if ( Loads(op) ) _uses[op] = true;
+
+	_nodes.push_back( Node{op, a, b, 0.0} );
+	return _shared[key] = _nodes.size() - 1;
+}
+
+void Expression::Emit(const std::size_t root){
+
+	// the nodes the result depends on (operands come before their nodes)
+	std::vector<bool> live(_nodes.size(), false);
+	live[root] = true;
+
+	for ( std::size_t k = root + 1; k-- > 0; ){
+
+		if ( !live[k] || _nodes[k].op == CONSTANT || Loads(_nodes[k].op) )
+			continue;
+
+		live[_nodes[k].a] = true;
+		if ( TakesTwo(_nodes[k].op) ) live[_nodes[k].b] = true;
+	}
+
+	std::fill(_uses, _uses + THETA + 1, false);
+	std::vector<std::uint16_t> reg(_nodes.size(), 0);
+	_registers = 0;
+
+	// constants first, they are copied in before the program runs
+	for ( std::size_t k = 0; k <= root; k++ ){
+
+		if ( !live[k] || _nodes[k].op != CONSTANT ) continue;
+
+		reg[k] = _registers++;
+		_pool.push_back(_nodes[k].value);
+	}
+
+	for ( std::size_t k = 0; k <= root; k++ ){
+
+		if ( !live[k] || _nodes[k].op == CONSTANT ) continue;
+
+		if ( _registers >= EXPRESSION_REGISTERS )
+			Fail("the expression is too long");
+
+		reg[k] = _registers++;
+		if ( Loads(_nodes[k].op) ) _uses[_nodes[k].op] = true;
+
+		_code.push_back( Instruction{_nodes[k].op, reg[k], reg[_nodes[k].a],
+			reg[_nodes[k].b]} );
+	}
+
+	_result = reg[root];
+
+	// nothing else is needed once compiled
+	_nodes.clear();
+	_shared.clear();
+	_constants.clear();
+}
+
+double Expression::Apply(const Operation op, const double a, const double b){
+
+	switch ( op ){
+
+		case ADD:      return a + b;
+		case SUBTRACT: return a - b;
+		case MULTIPLY: return a * b;
+		case DIVIDE:   return a / b;
+		case POWER:    return std::pow(a, b);
+		case NEGATE:   return -a;
+		case SQUARE:   return a * a;
+		case EXP:      return std::exp(a);
+		case LOG:      return std::log(a);
+		case LOG10:    return std::log10(a);
+		case SQRT:     return std::sqrt(a);
+		case ABS:      return std::abs(a);
+		case SIN:      return std::sin(a);
+		case COS:      return std::cos(a);
+		case TAN:      return std::tan(a);
+		case ASIN:     return std::asin(a);
+		case ACOS:     return std::acos(a);
+		case ATAN:     return std::atan(a);
+		case SINH:     return std::sinh(a);
+		case COSH:     return std::cosh(a);
+		case TANH:     return std::tanh(a);
+		case FLOOR:    return std::floor(a);
+		case CEIL:     return std::ceil(a);
+		case ATAN2:    return std::atan2(a, b);
+		case MIN:      return std::fmin(a, b);
+		case MAX:      return std::fmax(a, b);
+		default:       return a;
+	}
+}
+
+double Expression::Evaluate(const Point &point) const {
+
+	double r[EXPRESSION_REGISTERS];
+	std::copy(_pool.begin(), _pool.end(), r);
+
+	for ( const auto& ins : _code ){
+
+		double &target = r[ins.target];
+
+		switch ( ins.op ){
+
+			case X:     target = point.X();     break;
+			case Y:     target = point.Y();     break;
+			case Z:     target = point.Z();     break;
+			case R:     target = point.R();     break;
+			case RHO:   target = point.Rho();   break;
+			case PHI:   target = point.Phi();   break;
+			case THETA: target = point.Theta(); break;
+			default:    target = Apply(ins.op, r[ins.a], r[ins.b]);
+		}
+	}
+
+	return r[_result];
+}
+
+void Expression::Evaluate(const double *x, const double *y, const double *z,
+	const std::size_t n, double *out) const {
+
+	const std::size_t B = EXPRESSION_BLOCK;
+	std::vector<double> r(_registers * B);
+
+	for ( std::size_t start = 0; start < n; start += B ){
+
+		const std::size_t m = std::min(B, n - start);
+		const double *px = x + start, *py = y + start, *pz = z + start;
+
+		for ( std::size_t k = 0; k < _pool.size(); k++ )
+			std::fill(&r[k * B], &r[k * B] + m, _pool[k]);
+
+		for ( const auto& ins : _code ){
+
+			double *t = &r[ins.target * B];
+			const double *a = &r[ins.a * B], *b = &r[ins.b * B];
+
+			switch ( ins.op ){
+
+				case X: BLOCK( t[i] = px[i] );
+				case Y: BLOCK( t[i] = py[i] );
+				case Z: BLOCK( t[i] = pz[i] );
+				case R: BLOCK( t[i] = std::sqrt(px[i] * px[i] + py[i] * py[i]) );
+				case RHO: BLOCK( t[i] = std::sqrt(px[i] * px[i] +
+					py[i] * py[i] + pz[i] * pz[i]) );
+
+				// the corner cases of these are left to `Vector`
+				case PHI:
+					for ( std::size_t i = 0; i < m; i++ )
+						t[i] = Vector(px[i], py[i], pz[i]).Phi();
+					break;
+				case THETA:
+					for ( std::size_t i = 0; i < m; i++ )
+						t[i] = Vector(px[i], py[i], pz[i]).Theta();
+					break;
+
+				case ADD:      BLOCK( t[i] = a[i] + b[i] );
+				case SUBTRACT: BLOCK( t[i] = a[i] - b[i] );
+				case MULTIPLY: BLOCK( t[i] = a[i] * b[i] );
+				case DIVIDE:   BLOCK( t[i] = a[i] / b[i] );
+				case POWER:    BLOCK( t[i] = std::pow(a[i], b[i]) );
+				case NEGATE:   BLOCK( t[i] = -a[i] );
+				case SQUARE:   BLOCK( t[i] = a[i] * a[i] );
+				case EXP:      BLOCK( t[i] = std::exp(a[i]) );
+				case LOG:      BLOCK( t[i] = std::log(a[i]) );
+				case LOG10:    BLOCK( t[i] = std::log10(a[i]) );
+				case SQRT:     BLOCK( t[i] = std::sqrt(a[i]) );
+				case ABS:      BLOCK( t[i] = std::abs(a[i]) );
+				case SIN:      BLOCK( t[i] = std::sin(a[i]) );
+				case COS:      BLOCK( t[i] = std::cos(a[i]) );
+				case TAN:      BLOCK( t[i] = std::tan(a[i]) );
+				case ASIN:     BLOCK( t[i] = std::asin(a[i]) );
+				case ACOS:     BLOCK( t[i] = std::acos(a[i]) );
+				case ATAN:     BLOCK( t[i] = std::atan(a[i]) );
+				case SINH:     BLOCK( t[i] = std::sinh(a[i]) );
+				case COSH:     BLOCK( t[i] = std::cosh(a[i]) );
+				case TANH:     BLOCK( t[i] = std::tanh(a[i]) );
+				case FLOOR:    BLOCK( t[i] = std::floor(a[i]) );
+				case CEIL:     BLOCK( t[i] = std::ceil(a[i]) );
+				case ATAN2:    BLOCK( t[i] = std::atan2(a[i], b[i]) );
+				case MIN:      BLOCK( t[i] = std::fmin(a[i], b[i]) );
+				case MAX:      BLOCK( t[i] = std::fmax(a[i], b[i]) );
+				default: break;
+			}
+		}
+
+		std::copy(&r[_result * B], &r[_result * B] + m, out + start);
+	}
+}
+
+bool Expression::Axisymmetric() const {
+	return !_uses[X] && !_uses[Y] && !_uses[PHI];
+}
+
+bool Expression::Spherical() const {
+	return Axisymmetric() && !_uses[R] && !_uses[Z] && !_uses[THETA];
+}
+
+bool Expression::Planar() const {
+	return Axisymmetric() && !_uses[R] && !_uses[RHO] && !_uses[THETA];
+}
+
+} // namespace Gaia
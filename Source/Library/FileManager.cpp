@@ -4,12 +4,17 @@
 //
 // #TODO:0 source
 
-#include <fstream>
+#include <cmath>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
+#include <omp.h>
 
 #include <FileManager.hpp>
+#include <BinaryFile.hpp>
+#include <TextWriter.hpp>
+#include <Fits.hpp>
 #include <Parser.hpp>
 #include <Vector.hpp>
 #include <Exception.hpp>
@@ -37,6 +42,24 @@ void FileManager::Release( ) {
     }
 }
 
+FileManager::~FileManager(){
+
+    // finish anything still queued (errors can no longer be reported)
+    if ( writer.joinable() ) {
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            stopping = true;
+        }
+
+        ready.notify_all();
+        writer.join();
+    }
+
+    // closing writes the index of whatever made it to the archive
+    delete archive;
+}
+
 void FileManager::Initialize(){
 
     // get info from parser
@@ -46,68 +69,178 @@ void FileManager::Initialize(){
     raw_path = parser -> GetRawPath();
     out_path = parser -> GetOutPath();
     map_path = parser -> GetMapPath();
+    format   = parser -> GetFormat();
+    arc_path = parser -> GetArchivePath();
+
+    // positions and separations use the binary layout for `bin` and `bin32`
+    binary = format == "bin" || format == "bin32";
+    dtype  = format == "bin32" ? 4 : 8;
+
+    // tables and images for `fits`
+    fits = format == "fits";
+    axes = parser -> GetAxes();
+
+    // writes are handed to a background thread with `--async-io`
+    async     = parser -> GetAsyncFlag();
+    max_bytes = parser -> GetIOBuffer();
+
+    queued_bytes = 0;
+    busy = stopping = false;
+
+    // a resumed run appends to its archive
+    if ( parser -> GetArchiveFlag() && !archive )
+        archive = new Archive(arc_path, parser -> GetResumeFlag());
+
+    if ( async && !writer.joinable() )
+        writer = std::thread(&FileManager::Writer, this);
 }
 
-void FileManager::SavePositions(const std::vector<Vector> &positions,
-    const std::size_t trial ){
+void FileManager::Dispatch(std::function<void()> task,
+    const std::size_t bytes){
 
-    // build file name
-    std::stringstream buffer;
-    buffer << pos_path << trial << ".dat";
-    std::string filename = buffer.str();
+    //
+    // Queue a `task` for the writer thread. If the queue already holds
+    // `max_bytes` we wait for it to drain (a single task larger than the
+    // limit is still accepted once the queue is empty). An error from an
+    // earlier task is raised here, on the main thread.
+    //
 
-    // open file and write positions
-    std::ofstream output( filename.c_str() );
+    std::unique_lock<std::mutex> guard(lock);
 
-    if (output) {
+    space.wait(guard, [&]{ return error || queue.empty() ||
+        queued_bytes + bytes <= max_bytes; });
 
-        output.precision(16);
+    if ( error ) std::rethrow_exception(error);
 
-        if (verbose) std::cout
-            << "\n\n Saving position vectors to `"
-            << filename << "` ... ";
-            std::cout.flush();
+    queue.push_back( Job{std::move(task), bytes} );
+    queued_bytes += bytes;
 
-        for ( const auto& vec : positions )
-            output << vec << std::endl;
+    ready.notify_one();
+}
 
-        if (verbose)
-            std::cout << "done\n";
-            std::cout.flush();
+void FileManager::Drain(){
+
+    //
+    // Wait for the writer thread to finish everything queued and raise
+    // the first error it encountered (if any).
+    //
+
+    if ( !async ) return;
 
-    } else throw IOError("From FileManager::SavePositions(), I "
-    "couldn't open the file `" + filename + "`!");
+    std::unique_lock<std::mutex> guard(lock);
+    space.wait(guard, [&]{ return error || (queue.empty() && !busy); });
+
+    if ( error ) {
+
+        std::exception_ptr first = error;
+        error = nullptr;
+        std::rethrow_exception(first);
+    }
 }
 
-void FileManager::SaveRaw(const std::vector<double> &seperations,
-    const std::size_t trial){
+void FileManager::Close(){
+
+    //
+    // Finish all queued writes and write the index footer of the archive.
+    // Nothing more can be appended afterwards.
+    //
+
+    Drain();
+
+    if ( archive ) archive -> Close();
+}
+
+void FileManager::Resume(const std::size_t trial){
+
+    // anything the archive holds beyond the checkpoint is written again
+    if ( archive ) archive -> Discard(trial);
+}
+
+void FileManager::Writer(){
+
+    // the writer runs alongside the next trial, which already has the
+    // --num-threads threads, so anything it formats stays on this one
+    omp_set_num_threads(1);
+
+    std::unique_lock<std::mutex> guard(lock);
+
+    while ( true ){
+
+        ready.wait(guard, [&]{ return stopping || !queue.empty(); });
+
+        if ( queue.empty() ) return; // stopping and nothing left to do
+
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        busy = true;
+
+        // once a write fails the remaining tasks are skipped
+        bool skip = error != nullptr;
+
+        guard.unlock();
+
+        std::exception_ptr failure;
+        if ( !skip ) {
+
+            try { job.task(); }
+            catch (...) { failure = std::current_exception(); }
+        }
+
+        guard.lock();
+
+        if ( failure && !error ) error = failure;
+        queued_bytes -= job.bytes;
+        busy = false;
+
+        space.notify_all();
+    }
+}
+
+void FileManager::SavePositions(const PositionArray &positions,
+    const std::size_t trial ){
 
     // build file name
     std::stringstream buffer;
-    buffer << raw_path << trial << ".dat";
-    std::string filename = buffer.str();
+    buffer << pos_path << trial << (binary ? ".bin" : fits ? ".fits" : ".dat");
+    std::string filename = archive ? arc_path : buffer.str();
 
-    // open file and write positions
-    std::ofstream output( filename.c_str() );
+    if (verbose) std::cout
+        << "\n\n Saving position vectors to `"
+        << filename << "` ... ";
+        std::cout.flush();
 
-    if (output) {
+    // the writer thread keeps its own copy of the trial's positions
+    if ( async ) Dispatch([=](){ WritePositions(filename, positions, trial); },
+        positions.size() * 3 * sizeof(double));
 
-        output.precision(16);
+    else WritePositions(filename, positions, trial);
 
-        if (verbose) std::cout
-            << "\n\n Saving raw nearest neighbor distances to `"
-            << filename << "` ... ";
-            std::cout.flush();
+    if (verbose)
+        std::cout << (async ? "queued\n" : "done\n");
+        std::cout.flush();
+}
 
-        for ( const auto& sep : seperations )
-            output << sep << std::endl;
+void FileManager::SaveRaw(const std::vector<double> &seperations,
+    const std::size_t trial){
 
-        if (verbose)
-            std::cout << "done\n";
-            std::cout.flush();
+    // build file name
+    std::stringstream buffer;
+    buffer << raw_path << trial << (binary ? ".bin" : fits ? ".fits" : ".dat");
+    std::string filename = archive ? arc_path : buffer.str();
+
+    if (verbose) std::cout
+        << "\n\n Saving raw nearest neighbor distances to `"
+        << filename << "` ... ";
+        std::cout.flush();
+
+    if ( async ) Dispatch([=](){ WriteRaw(filename, seperations, trial); },
+        seperations.size() * sizeof(double));
+
+    else WriteRaw(filename, seperations, trial);
 
-    } else throw IOError("From FileManager::SaveRaw(), I "
-    "couldn't open the file `" + filename + "`!");
+    if (verbose)
+        std::cout << (async ? "queued\n" : "done\n");
+        std::cout.flush();
 }
 
 void FileManager::SaveMap( const std::map<std::string, std::vector<double>> Axis ){
@@ -116,6 +249,9 @@ void FileManager::SaveMap( const std::map<std::string, std::vector<double>> Axis
     // Save the axis information the results were mapped to.
     //
 
+    // kept for the world coordinates of FITS images
+    linespaces = Axis;
+
     for ( const auto& ax : Axis ){
 
         // build file name
@@ -128,21 +264,18 @@ void FileManager::SaveMap( const std::map<std::string, std::vector<double>> Axis
             << filename << "` ... ";
             std::cout.flush();
 
-        // open file and write out `map` coordinates
-        std::ofstream output( filename.c_str() );
-
-        if (output) {
-
-            output.precision(16);
+        // write out `map` coordinates
+        std::vector<double> coordinates = ax.second;
 
-            for ( const auto& x : ax.second )
-                output << x << std::endl;
+        if ( async ) Dispatch([=](){ TextWriter::Write(filename,
+            {coordinates.data()}, coordinates.size()); },
+            coordinates.size() * sizeof(double));
 
-        } else throw IOError("From FileManager::SaveMap(), I couldn't open "
-        "the file, `" + filename + "`!");
+        else TextWriter::Write(filename, {coordinates.data()},
+            coordinates.size());
 
         if (verbose)
-            std::cout<< "done\n";
+            std::cout << (async ? "queued\n" : "done\n");
             std::cout.flush();
     }
 }
@@ -156,8 +289,8 @@ void FileManager::SaveOutput(const std::vector<double> &mean,
 
     // build file name
     std::stringstream buffer;
-    buffer << out_path << trial << ".dat";
-    std::string filename = buffer.str();
+    buffer << out_path << trial << (fits ? ".fits" : ".dat");
+    std::string filename = archive ? arc_path : buffer.str();
 
     if (verbose) std::cout
         << "\n\n Saving Profile data to `"
@@ -169,21 +302,14 @@ void FileManager::SaveOutput(const std::vector<double> &mean,
     for (std::size_t i = 0; i < stdev.size(); i++)
         stdev[i] = std::sqrt(variance[i]);
 
-    // open file and write positions
-    std::ofstream output( filename.c_str() );
-
-    if (output) {
-
-        output.precision(16);
+    // write mean and standard deviation as two columns
+    if ( async ) Dispatch([=](){ WriteOutput(filename, mean, stdev, trial); },
+        2 * mean.size() * sizeof(double));
 
-        for (std::size_t i = 0; i < mean.size(); i++)
-            output << mean[i] << " " << stdev[i] << std::endl;
-
-    } else throw IOError("From FileManager::SaveOutput(), I "
-        "couldn't open the file, `" + filename + "`!");
+    else WriteOutput(filename, mean, stdev, trial);
 
     if (verbose)
-        std::cout << "done\n";
+        std::cout << (async ? "queued\n" : "done\n");
         std::cout.flush();
 }
 
@@ -200,6 +326,31 @@ void FileManager::SaveOutput( const std::vector< std::vector<double> > &mean,
         for ( auto& element : row )
                 element = std::sqrt(element);
 
+        // mean and standard deviation are two images of one FITS file
+        if ( fits && !archive ) {
+
+                std::stringstream buffer;
+                buffer << out_path << trial << ".fits";
+                std::string filename = buffer.str();
+
+                if (verbose) std::cout
+                        << "\n\n Saving `mean` and `stdev` images to file, `"
+                        << filename << "` ... ";
+                        std::cout.flush();
+
+                if ( async ) Dispatch([=](){ WriteImages(filename, mean, stdev,
+                        trial); }, 2 * mean.size() * (mean.empty() ? 0 :
+                        mean[0].size()) * sizeof(double));
+
+                else WriteImages(filename, mean, stdev, trial);
+
+                if (verbose)
+                        std::cout << (async ? "queued" : "done");
+                        std::cout.flush();
+
+                return;
+        }
+
         // create map to shorten notation ...
         std::map< std::string, std::vector< std::vector<double> > > results;
         results["mean"]  = mean;
@@ -211,35 +362,137 @@ void FileManager::SaveOutput( const std::vector< std::vector<double> > &mean,
                 // build file name
                 std::stringstream buffer;
                 buffer << out_path << trial << "-" << matrix.first << ".dat";
-                std::string filename = buffer.str();
+                std::string filename = archive ? arc_path : buffer.str();
 
                 if (verbose) std::cout
                         << "\n\n Saving `" << matrix.first << "` data to file, `"
                         << filename << "` ... ";
                         std::cout.flush();
 
-                // open file and write positions
-                std::ofstream output( filename.c_str() );
+                // write the matrix, one row per line
+                const std::vector< std::vector<double> > &data = matrix.second;
+                const std::string kind = matrix.first;
 
-                if (output) {
+                if ( async ) Dispatch([=](){ WriteMatrix(filename, data, kind,
+                        trial); }, data.size() * (data.empty() ? 0 :
+                        data[0].size()) * sizeof(double));
 
-                        output.precision(16);
+                else WriteMatrix(filename, data, kind, trial);
 
-                        for ( const auto& row : matrix.second ){
+                if (verbose)
+                        std::cout << (async ? "queued" : "done");
+                        std::cout.flush();
+        }
+}
 
-                                for ( const auto& element : row )
-                                        output << element << " ";
+void FileManager::WritePositions(const std::string &filename,
+    const PositionArray &positions, const std::size_t trial){
 
-                                output << std::endl;
-                        }
+    // the binary layouts store each coordinate contiguously, as we do
+    const double *x = positions.X(), *y = positions.Y(), *z = positions.Z();
 
-                } else throw IOError("From FileManager::SaveOutput(), I "
-                        "couldn't open the file, `" + filename + "`!");
+    if ( binary || archive || fits ) {
 
-                if (verbose)
-                        std::cout << "done";
-                        std::cout.flush();
-        }
+        BinaryFile::Header header = BinaryFile::NewHeader("pos",
+            positions.size(), 3, trial, dtype);
+
+        if ( archive ) archive -> Append(header, {x, y, z});
+
+        else if ( fits ) {
+
+            Fits table(filename);
+            table.Table("POS", {"X", "Y", "Z"}, {x, y, z}, positions.size(),
+                trial);
+            table.Close();
+
+        } else BinaryFile::Write(filename, header, {x, y, z});
+
+    } else TextWriter::Write(filename, {x, y, z}, positions.size());
+}
+
+void FileManager::WriteRaw(const std::string &filename,
+    const std::vector<double> &seperations, const std::size_t trial){
+
+    if ( archive )
+        archive -> Append(BinaryFile::NewHeader("raw", seperations.size(), 1,
+            trial, dtype), {seperations.data()});
+
+    else if ( binary )
+        BinaryFile::Write(filename, BinaryFile::NewHeader("raw",
+            seperations.size(), 1, trial, dtype), {seperations.data()});
+
+    else if ( fits ) {
+
+        Fits table(filename);
+        table.Table("RAW", {"SEPARATION"}, {seperations.data()},
+            seperations.size(), trial);
+        table.Close();
+    }
+
+    else TextWriter::Write(filename, {seperations.data()}, seperations.size());
+}
+
+void FileManager::WriteOutput(const std::string &filename,
+    const std::vector<double> &mean, const std::vector<double> &stdev,
+    const std::size_t trial){
+
+    // results are always kept as float64
+    if ( archive )
+        archive -> Append(BinaryFile::NewHeader("out", mean.size(), 2, trial),
+            {mean.data(), stdev.data()});
+
+    else if ( fits ) {
+
+        // the coordinate of each row is stored alongside the results
+        const std::vector<double> &axis = linespaces.at(axes[0]);
+
+        Fits table(filename);
+        table.Table("OUT", {axes[0], "MEAN", "STDEV"}, {axis.data(),
+            mean.data(), stdev.data()}, mean.size(), trial);
+        table.Close();
+    }
+
+    else TextWriter::Write(filename, {mean.data(), stdev.data()}, mean.size());
+}
+
+void FileManager::WriteImages(const std::string &filename,
+    const std::vector< std::vector<double> > &mean,
+    const std::vector< std::vector<double> > &stdev, const std::size_t trial){
+
+    std::vector< std::vector<double> > coordinates = {
+        linespaces.at(axes[0]), linespaces.at(axes[1]) };
+
+    Fits images(filename);
+    images.Image("MEAN",  mean,  axes, coordinates, trial);
+    images.Image("STDEV", stdev, axes, coordinates, trial);
+    images.Close();
+}
+
+void FileManager::WriteMatrix(const std::string &filename,
+    const std::vector< std::vector<double> > &data, const std::string &kind,
+    const std::size_t trial){
+
+    std::size_t rows    = data.size();
+    std::size_t columns = data.empty() ? 0 : data[0].size();
+
+    if ( archive ) {
+
+        // a record holds contiguous columns, so the matrix is transposed
+        std::vector< std::vector<double> > stored(columns,
+            std::vector<double>(rows));
+
+        for ( std::size_t i = 0; i < rows; i++ )
+        for ( std::size_t j = 0; j < columns; j++ )
+            stored[j][i] = data[i][j];
+
+        std::vector<const double*> pointers;
+        for ( const auto& column : stored ) pointers.push_back(column.data());
+
+        archive -> Append(BinaryFile::NewHeader(kind, rows, columns, trial),
+            pointers);
+
+    } else TextWriter::Write(filename, rows, columns,
+        [&data](std::size_t i, std::size_t j){ return data[i][j]; });
 }
 
 } // namespace Gaia
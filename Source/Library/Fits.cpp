@@ -0,0 +1,437 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/Fits.cc
+//
+// Source file for the `Fits` class. See Include/Fits.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Fits.hpp>
+#include <BinaryFile.hpp>
+#include <TextWriter.hpp>
+#include <Parser.hpp>
+#include <Exception.hpp>
+
+// size of a FITS block (headers and data are padded to this)
+#define FITS_BLOCK  2880
+
+// data is converted and written through a buffer of this many blocks
+#define FITS_BUFFER 364
+
+namespace Gaia {
+
+namespace {
+
+// one 80 character header card, `value` is already formatted
+std::string Card(const std::string &keyword, const std::string &value,
+	const std::string &comment = ""){
+
+	std::string card = keyword;
+	card.resize(8, ' ');
+	card += "= ";
+
+	// fixed format, numbers and logicals end in column 30
+	if ( value.size() < 20 && value[0] != '\'' )
+		card += std::string(20 - value.size(), ' ');
+
+	card += value;
+	if ( !comment.empty() ) card += " / " + comment;
+
+	card.resize(80, ' ');
+	return card;
+}
+
+std::string String(const std::string &value){
+
+	// quotes are escaped by doubling them, at least 8 characters wide
+	std::string quoted;
+	for ( const auto& c : value ){
+		quoted += c;
+		if ( c == '\'' ) quoted += c;
+	}
+
+	if ( quoted.size() < 8 ) quoted.resize(8, ' ');
+	return "'" + quoted + "'";
+}
+
+std::string Integer(const unsigned long long value){
+	return std::to_string(value);
+}
+
+std::string Real(const double value){
+
+	// shortest round-trip digits, written with an upper case exponent and
+	// always a decimal point so no reader takes it for an integer
+	std::string text = TextWriter::Format(value);
+	std::size_t e = text.find('e');
+
+	if ( e != std::string::npos ) text[e] = 'E';
+	else e = text.size();
+
+	if ( text.find('.') == std::string::npos &&
+		text.find("inf") == std::string::npos &&
+		text.find("nan") == std::string::npos ) text.insert(e, ".0");
+
+	return text;
+}
+
+// the keywords and (unquoted, trimmed) values of the header at the current
+// position of `input`, which is left at its data (false at the end of file)
+bool Header(FILE *input, std::map<std::string, std::string> &keywords){
+
+	keywords.clear();
+	char card[80];
+
+	for ( std::size_t cards = 1; std::fread(card, 1, 80, input) == 80;
+		cards++ ){
+
+		std::string line(card, 80);
+		std::string keyword = line.substr(0, 8);
+		keyword.erase(keyword.find_last_not_of(' ') + 1);
+
+		if ( keyword == "END" ){
+
+			// the rest of the block is padding
+			std::size_t per_block = FITS_BLOCK / 80;
+			std::fseek(input, (per_block - cards % per_block) % per_block * 80,
+				SEEK_CUR);
+			return true;
+		}
+
+		if ( line.compare(8, 2, "= ") ) continue;
+
+		// a string ends at its closing quote, anything else at a comment
+		std::string value = line.substr(10);
+		std::size_t start = value.find_first_not_of(' ');
+
+		if ( start == std::string::npos ) continue;
+
+		if ( value[start] == '\'' )
+			value = value.substr(start + 1, value.find('\'', start + 1) -
+				start - 1);
+		else
+			value = value.substr(start, value.find('/') - start);
+
+		value.erase(value.find_last_not_of(' ') + 1);
+		keywords[keyword] = value;
+	}
+
+	return false;
+}
+
+} // anonymous namespace
+
+Fits::Fits(const std::string &filename){
+
+	_filename = filename;
+	_primary  = false;
+	_file     = std::fopen(filename.c_str(), "wb");
+
+	if ( !_file ) throw IOError("From Fits::Fits(), I couldn't open "
+		"the file `" + filename + "`!");
+}
+
+Fits::~Fits(){
+
+	if ( _file ) std::fclose(_file);
+}
+
+void Fits::Close(){
+
+	if ( !_file ) return;
+
+	bool good = !std::fclose(_file);
+	_file = nullptr;
+
+	if ( !good ) throw IOError("From Fits::Close(), I failed writing to `" +
+		_filename + "`!");
+}
+
+void Fits::Write(std::string &cards){
+
+	cards += "END" + std::string(77, ' ');
+
+	std::size_t blocks = (cards.size() + FITS_BLOCK - 1) / FITS_BLOCK;
+	cards.resize(blocks * FITS_BLOCK, ' ');
+
+	if ( std::fwrite(cards.data(), 1, cards.size(), _file) != cards.size() )
+		throw IOError("From Fits::Write(), I failed writing to `" +
+		_filename + "`!");
+}
+
+template<class Accessor>
+void Fits::Data(const std::size_t count, Accessor get){
+
+	//
+	// The buffer is a whole number of blocks (and of values) so every
+	// write but the last is block aligned in the file.
+	//
+
+	const std::size_t length = FITS_BUFFER * FITS_BLOCK / sizeof(double);
+	std::vector<double> buffer( std::min(length, count) );
+
+	bool swap = BinaryFile::LittleEndian();
+
+	for ( std::size_t first = 0; first < count; first += length ){
+
+		std::size_t n = std::min(length, count - first);
+
+		for ( std::size_t k = 0; k < n; k++ )
+			buffer[k] = get(first + k);
+
+		if ( swap ) BinaryFile::Swap(buffer.data(), sizeof(double), n);
+
+		if ( std::fwrite(buffer.data(), sizeof(double), n, _file) != n )
+			throw IOError("From Fits::Data(), I failed writing to `" +
+			_filename + "`!");
+	}
+
+	// the last block is padded with zeros
+	std::size_t bytes = (count * sizeof(double)) % FITS_BLOCK;
+
+	if ( bytes ){
+
+		std::vector<char> padding(FITS_BLOCK - bytes, 0);
+
+		if ( std::fwrite(padding.data(), 1, padding.size(), _file) !=
+			padding.size() ) throw IOError("From Fits::Data(), I failed "
+			"writing to `" + _filename + "`!");
+	}
+}
+
+void Fits::Common(std::string &cards, const std::string &extname,
+	const std::size_t trial){
+
+	Parser *parser = Parser::GetInstance();
+	std::vector<double> X = parser -> GetXlimits();
+	std::vector<double> Y = parser -> GetYlimits();
+	std::vector<double> Z = parser -> GetZlimits();
+
+	cards += Card("EXTNAME",  String(extname));
+	cards += Card("TRIAL",    Integer(trial), "trial number (0 for pooled)");
+	cards += Card("SEED",     Integer(parser -> GetFirstSeed()), "first seed");
+	cards += Card("XMIN",     Real(X[0]));
+	cards += Card("XMAX",     Real(X[1]));
+	cards += Card("YMIN",     Real(Y[0]));
+	cards += Card("YMAX",     Real(Y[1]));
+	cards += Card("ZMIN",     Real(Z[0]));
+	cards += Card("ZMAX",     Real(Z[1]));
+	cards += Card("CREATOR",  String("Gaia"));
+}
+
+void Fits::Table(const std::string &extname,
+	const std::vector<std::string> &names,
+	const std::vector<const double*> &columns, const std::size_t rows,
+	const std::size_t trial){
+
+	if ( !_file ) throw IOError("From Fits::Table(), `" + _filename +
+		"` was already closed!");
+
+	// a table can't be the primary HDU
+	if ( !_primary ){
+
+		std::string cards;
+		cards += Card("SIMPLE", "T", "conforms to FITS standard");
+		cards += Card("BITPIX", "8");
+		cards += Card("NAXIS",  "0");
+		cards += Card("EXTEND", "T");
+		Write(cards);
+
+		_primary = true;
+	}
+
+	std::size_t fields = columns.size();
+
+	std::string cards;
+	cards += Card("XTENSION", String("BINTABLE"), "binary table extension");
+	cards += Card("BITPIX",   "8");
+	cards += Card("NAXIS",    "2");
+	cards += Card("NAXIS1",   Integer(fields * sizeof(double)), "bytes per row");
+	cards += Card("NAXIS2",   Integer(rows), "number of rows");
+	cards += Card("PCOUNT",   "0");
+	cards += Card("GCOUNT",   "1");
+	cards += Card("TFIELDS",  Integer(fields));
+
+	for ( std::size_t j = 0; j < fields; j++ ){
+
+		std::string n = std::to_string(j + 1);
+		cards += Card("TTYPE" + n, String(names[j]));
+		cards += Card("TFORM" + n, String("1D"));
+	}
+
+	Common(cards, extname, trial);
+	Write(cards);
+
+	// rows are stored one after the other
+	Data(rows * fields, [&columns, fields](std::size_t k){
+		return columns[k % fields][k / fields]; });
+}
+
+void Fits::Image(const std::string &extname,
+	const std::vector< std::vector<double> > &data,
+	const std::vector<std::string> &names,
+	const std::vector< std::vector<double> > &axes, const std::size_t trial){
+
+	if ( !_file ) throw IOError("From Fits::Image(), `" + _filename +
+		"` was already closed!");
+
+	std::size_t width  = data.size();
+	std::size_t height = data.empty() ? 0 : data[0].size();
+
+	bool primary = !_primary;
+	std::string cards;
+
+	if ( primary ) cards += Card("SIMPLE", "T", "conforms to FITS standard");
+	else cards += Card("XTENSION", String("IMAGE"), "image extension");
+
+	cards += Card("BITPIX", "-64", "float64");
+	cards += Card("NAXIS",  "2");
+	cards += Card("NAXIS1", Integer(width));
+	cards += Card("NAXIS2", Integer(height));
+
+	if ( primary ) cards += Card("EXTEND", "T");
+	else {
+		cards += Card("PCOUNT", "0");
+		cards += Card("GCOUNT", "1");
+	}
+
+	// linear world coordinates from the linespace of each axis
+	for ( std::size_t a = 0; a < 2 && a < axes.size(); a++ ){
+
+		const std::vector<double> &axis = axes[a];
+		std::string n = std::to_string(a + 1);
+
+		double delta = axis.size() > 1 ?
+			(axis.back() - axis.front()) / double(axis.size() - 1) : 1.0;
+
+		cards += Card("CTYPE" + n, String(names[a]));
+		cards += Card("CRPIX" + n, Real(1.0));
+		cards += Card("CRVAL" + n, Real(axis.front()));
+		cards += Card("CDELT" + n, Real(delta));
+
+		if ( names[a] == "Phi" || names[a] == "Theta" )
+			cards += Card("CUNIT" + n, String("rad"));
+	}
+
+	Common(cards, extname, trial);
+	Write(cards);
+	_primary = true;
+
+	// the first axis varies fastest
+	Data(width * height, [&data, width](std::size_t k){
+		return data[k % width][k / width]; });
+}
+
+void Fits::ReadCube(const std::string &filename, std::size_t shape[3],
+	std::vector<double> &data){
+
+	FILE *input = std::fopen(filename.c_str(), "rb");
+
+	if ( !input ) throw IOError("From Fits::ReadCube(), I couldn't open "
+		"the file `" + filename + "`!");
+
+	std::map<std::string, std::string> keywords;
+	bool found = false;
+
+	for ( bool first = true; !found && Header(input, keywords); first = false ){
+
+		auto Get = [&keywords](const std::string &keyword, const long value){
+			return keywords.count(keyword) ?
+				std::atol(keywords[keyword].c_str()) : value; };
+
+		if ( first && keywords["SIMPLE"] != "T" ) break;
+
+		long bitpix = Get("BITPIX", 0), axes = Get("NAXIS", 0);
+		std::size_t count = axes > 0 ? 1 : 0;
+
+		for ( long a = 1; a <= axes; a++ )
+			count *= Get("NAXIS" + std::to_string(a), 0);
+
+		found = axes == 3 && count > 0 && ( first ||
+			keywords["XTENSION"] == "IMAGE" );
+
+		if ( !found ){
+
+			// skip to the next HDU
+			std::size_t bytes = std::labs(bitpix) / 8 * Get("GCOUNT", 1) *
+				( Get("PCOUNT", 0) + count );
+			std::fseek(input, (bytes + FITS_BLOCK - 1) / FITS_BLOCK *
+				FITS_BLOCK, SEEK_CUR);
+			continue;
+		}
+
+		for ( int a = 0; a < 3; a++ )
+			shape[a] = Get("NAXIS" + std::to_string(a + 1), 0);
+
+		double scale = keywords.count("BSCALE") ?
+			std::atof(keywords["BSCALE"].c_str()) : 1.0;
+		double zero  = keywords.count("BZERO") ?
+			std::atof(keywords["BZERO"].c_str()) : 0.0;
+		bool blank   = keywords.count("BLANK") > 0;
+		long long blank_value = blank ?
+			std::atoll(keywords["BLANK"].c_str()) : 0;
+
+		std::size_t size = std::labs(bitpix) / 8;
+
+		if ( bitpix != 8 && bitpix != 16 && bitpix != 32 && bitpix != 64 &&
+			bitpix != -32 && bitpix != -64 ){
+
+			std::fclose(input);
+			throw IOError("From Fits::ReadCube(), `" + filename + "` has "
+				"an unsupported BITPIX!");
+		}
+
+		std::vector<unsigned char> raw(count * size);
+
+		if ( std::fread(raw.data(), size, count, input) != count ){
+
+			std::fclose(input);
+			throw IOError("From Fits::ReadCube(), `" + filename + "` ended "
+				"before the data of the cube!");
+		}
+
+		// FITS is big-endian
+		if ( BinaryFile::LittleEndian() && size > 1 )
+			BinaryFile::Swap(raw.data(), size, count);
+
+		data.resize(count);
+		const unsigned char *pixel = raw.data();
+
+		for ( std::size_t k = 0; k < count; k++, pixel += size ){
+
+			double value;
+			long long integer = 0;
+
+			switch ( bitpix ){
+
+				case   8: integer = *pixel; break;
+				case  16: integer = *(const std::int16_t*) pixel; break;
+				case  32: integer = *(const std::int32_t*) pixel; break;
+				case  64: integer = *(const std::int64_t*) pixel; break;
+			}
+
+			if ( bitpix == -32 ) value = *(const float*)  pixel;
+			else if ( bitpix == -64 ) value = *(const double*) pixel;
+			else value = blank && integer == blank_value ? NAN :
+				double(integer);
+
+			value = zero + scale * value;
+			data[k] = std::isfinite(value) ? value : 0.0;
+		}
+	}
+
+	std::fclose(input);
+
+	if ( !found ) throw IOError("From Fits::ReadCube(), `" + filename + "` "
+		"has no image with three axes!");
+}
+
+} // namespace Gaia
@@ -3,8 +3,12 @@
 // Library/Interpolation.cc
 //
 // General interpolation objects. Interp1D and Interp2D provide
-// Linear and Bilinear Interpolation respectively.
+// Linear and Bilinear Interpolation respectively, TriLinear interpolates a
+// cube on a uniform grid. BiCubic is a smooth (Catmull-Rom) alternative to
+// BiLinear on a uniform grid.
 
+#include <cmath>
+#include <string>
 #include <vector>
 #include <iostream>
 #include <algorithm>
@@ -15,6 +19,116 @@ namespace Gaia {
 
 namespace Interpolate {
 
+namespace {
+
+// check that `axis` is evenly spaced and ascending, and return its spacing
+template<class T>
+T Spacing(const std::vector<T> &axis, const std::string &from){
+
+    if ( axis.size() < 2 )
+    throw InterpError("From " + from + ", each axis needs at least two "
+    "values!");
+
+    T step = (axis.back() - axis.front()) / T(axis.size() - 1);
+
+    if ( !(step > 0) )
+    throw InterpError("From " + from + ", an axis was not in ascending "
+    "order!");
+
+    for (std::size_t i = 1; i < axis.size(); i++)
+    if ( std::abs(axis[i] - axis[i-1] - step) > 1e-6 * step )
+    throw InterpError("From " + from + ", an axis was not evenly spaced!");
+
+    return step;
+}
+
+// index of the cell of `value` on a uniform axis and the fraction within it
+template<class T>
+std::size_t Uniform(const T &value, const T &origin, const T &inverse,
+    const std::size_t size, T &fraction){
+
+    T t = (value - origin) * inverse;
+    T last = T(size - 2);
+
+    T cell = std::floor(t);
+    cell = cell < 0 ? 0 : cell > last ? last : cell;
+
+    fraction = t - cell;
+    fraction = fraction < 0 ? 0 : fraction > 1 ? 1 : fraction;
+
+    return std::size_t(cell);
+}
+
+// true if `axis` is evenly spaced (within rounding), and then its first
+// value and inverse spacing
+template<class T>
+bool Even(const std::vector<T> &axis, T &origin, T &inverse){
+
+    if ( axis.size() < 2 ) return false;
+
+    T step = (axis.back() - axis.front()) / T(axis.size() - 1);
+
+    if ( !(step > 0) ) return false;
+
+    for (std::size_t i = 1; i < axis.size(); i++)
+    if ( std::abs(axis[i] - axis[i-1] - step) > 1e-6 * step ) return false;
+
+    origin  = axis.front();
+    inverse = T(1) / step;
+
+    return true;
+}
+
+//
+// The interval of each of `n` values on an ascending `axis`, as the index
+// `i` of its upper end (axis[i-1] <= value < axis[i], clamped to the first
+// and last interval), handed to `use(k, i)` for value `k`. Evenly spaced
+// axes compute it, otherwise the values are sorted through `order` and
+// merged with the axis, or each is searched for if `order` is null.
+//
+template<class T, class Use>
+void Locate(const std::vector<T> &axis, const bool uniform, const T &origin,
+    const T &inverse, const T *value, const std::size_t n,
+    std::size_t *order, Use use){
+
+    const std::size_t last = axis.size() - 1;
+
+    if ( uniform ){
+
+        for (std::size_t k = 0; k < n; k++){
+
+            T t = std::floor( (value[k] - origin) * inverse ) + 1;
+            use(k, t < 1 ? 1 : t > T(last) ? last : std::size_t(t));
+        }
+
+    } else if ( !order ){
+
+        for (std::size_t k = 0; k < n; k++){
+
+            std::size_t i = std::upper_bound(axis.begin(), axis.end(),
+                value[k]) - axis.begin();
+            use(k, i < 1 ? 1 : i > last ? last : i);
+        }
+
+    } else {
+
+        for (std::size_t k = 0; k < n; k++) order[k] = k;
+
+        std::sort(order, order + n, [value](std::size_t a, std::size_t b){
+            return value[a] < value[b]; });
+
+        std::size_t i = 1;
+
+        for (std::size_t k = 0; k < n; k++){
+
+            while ( i < last && axis[i] <= value[ order[k] ] ) i++;
+            use(order[k], i);
+        }
+    }
+}
+
+} // anonymous namespace
+
 template<class T>
 Linear<T>::Linear(const std::vector<T> &x_, const std::vector<T> &y_){
 
@@ -38,6 +152,8 @@ Linear<T>::Linear(const std::vector<T> &x_, const std::vector<T> &y_){
     // solve all changes
     for (std::size_t i = 1; i < x.size(); i++)
         m[i] = (y[i] - y[i-1]) / (x[i] - x[i-1]);
+
+    uniform = Even(x, origin, inverse);
 }
 
 template<class T>
@@ -71,6 +187,21 @@ T Linear<T>::Interpolate(const T &x_){
     return m[i] * (x_ - x[i-1]) + y[i-1];
 }
 
+template<class T>
+void Linear<T>::Interpolate(const T *x_, const std::size_t n, T *out,
+    std::size_t *order) const {
+
+    if ( x.size() < 2 ){
+
+        for (std::size_t k = 0; k < n; k++) out[k] = y[0];
+        return;
+    }
+
+    Locate(x, uniform, origin, inverse, x_, n, order,
+        [this, x_, out](std::size_t k, std::size_t i){
+            out[k] = m[i] * (x_[k] - x[i-1]) + y[i-1]; });
+}
+
 template<class T>
 BiLinear<T>::BiLinear( const std::vector<T> &x_, const std::vector<T> &y_,
     const std::vector< std::vector<T> > &z_ ){
@@ -114,6 +245,9 @@ BiLinear<T>::BiLinear( const std::vector<T> &x_, const std::vector<T> &y_,
         Linear<T> row(x, z[i]);
         partial.push_back(row);
     }
+
+    uniform[0] = Even(x, origin[0], inverse[0]);
+    uniform[1] = Even(y, origin[1], inverse[1]);
 }
 
 template<class T>
@@ -166,6 +300,209 @@ T BiLinear<T>::Interpolate(const T &x_, const T &y_){
     return R1 + (y_ - y[i-1]) * (R2 - R1) / (y[i] - y[i-1]);
 }
 
+template<class T>
+BiCubic<T>::BiCubic(const std::vector<T> &x_, const std::vector<T> &y_,
+    const std::vector< std::vector<T> > &z_){
+
+    if ( z_.empty() )
+    throw InterpError("From BiCubic::BiCubic(), the `z` matrix was "
+    "empty!");
+
+    for (std::size_t i = 0; i < z_.size(); i++) if ( z_[i].size() != x_.size() )
+    throw InterpError("From BiCubic::BiCubic(), the size of `x` should "
+    "equal the columns in every row of `z`!");
+
+    if ( y_.size() != z_.size() )
+    throw InterpError("From BiCubic::BiCubic(), size of `y` should "
+    "equal the rows in `z`!");
+
+    origin[0]  = x_.front();
+    origin[1]  = y_.front();
+    inverse[0] = T(1) / Spacing(x_, "BiCubic::BiCubic()");
+    inverse[1] = T(1) / Spacing(y_, "BiCubic::BiCubic()");
+    size[0]    = x_.size();
+    size[1]    = y_.size();
+
+    std::size_t nx = size[0], ny = size[1];
+
+    //
+    // Catmull-Rom slopes (per cell) at every node, central differences
+    // inside and one sided at the edges, the cross one from the slopes
+    //
+
+    auto Slope = [](const T &before, const T &after, const std::size_t span){
+        return (after - before) / T(span); };
+
+    std::vector< std::vector<T> > dx(ny, std::vector<T>(nx));
+    std::vector< std::vector<T> > dy(ny, std::vector<T>(nx));
+    std::vector< std::vector<T> > dxy(ny, std::vector<T>(nx));
+
+    for (std::size_t j = 0; j < ny; j++)
+    for (std::size_t i = 0; i < nx; i++){
+
+        std::size_t a = i ? i - 1 : 0, b = i + 1 < nx ? i + 1 : i;
+        std::size_t c = j ? j - 1 : 0, d = j + 1 < ny ? j + 1 : j;
+
+        dx[j][i] = Slope(z_[j][a], z_[j][b], b - a);
+        dy[j][i] = Slope(z_[c][i], z_[d][i], d - c);
+    }
+
+    for (std::size_t j = 0; j < ny; j++)
+    for (std::size_t i = 0; i < nx; i++){
+
+        std::size_t c = j ? j - 1 : 0, d = j + 1 < ny ? j + 1 : j;
+        dxy[j][i] = Slope(dx[c][i], dx[d][i], d - c);
+    }
+
+    //
+    // The coefficients of a cell are M F M^T, F holding the values and
+    // slopes at its corners (first index along `x`, second along `y`)
+    //
+
+    static const T M[4][4] = { {  1,  0,  0,  0 }, {  0,  0,  1,  0 },
+                               { -3,  3, -2, -1 }, {  2, -2,  1,  1 } };
+
+    coefficients.resize((nx - 1) * (ny - 1) * 16);
+
+    for (std::size_t j = 0; j + 1 < ny; j++)
+    for (std::size_t i = 0; i + 1 < nx; i++){
+
+        T F[4][4] = {
+            { z_[j][i],     z_[j+1][i],     dy[j][i],      dy[j+1][i]     },
+            { z_[j][i+1],   z_[j+1][i+1],   dy[j][i+1],    dy[j+1][i+1]   },
+            { dx[j][i],     dx[j+1][i],     dxy[j][i],     dxy[j+1][i]    },
+            { dx[j][i+1],   dx[j+1][i+1],   dxy[j][i+1],   dxy[j+1][i+1]  } };
+
+        T MF[4][4];
+        for (int p = 0; p < 4; p++)
+        for (int q = 0; q < 4; q++){
+            MF[p][q] = 0;
+            for (int k = 0; k < 4; k++) MF[p][q] += M[p][k] * F[k][q];
+        }
+
+        T *a = coefficients.data() + (j * (nx - 1) + i) * 16;
+
+        for (int p = 0; p < 4; p++)
+        for (int q = 0; q < 4; q++){
+            a[4 * p + q] = 0;
+            for (int k = 0; k < 4; k++) a[4 * p + q] += MF[p][k] * M[q][k];
+        }
+    }
+}
+
+template<class T>
+std::size_t BiCubic<T>::Cell(const int axis, const T &value,
+    T &fraction) const {
+
+    return Uniform(value, origin[axis], inverse[axis], size[axis], fraction);
+}
+
+template<class T>
+T BiCubic<T>::Interpolate(const T &x_, const T &y_) const {
+
+    T u, v;
+    std::size_t i = Cell(0, x_, u), j = Cell(1, y_, v);
+
+    const T *a = coefficients.data() + (j * (size[0] - 1) + i) * 16;
+
+    // Horner in `v` for each power of `u`, then in `u`
+    T b3 = ((a[15] * v + a[14]) * v + a[13]) * v + a[12];
+    T b2 = ((a[11] * v + a[10]) * v + a[ 9]) * v + a[ 8];
+    T b1 = ((a[ 7] * v + a[ 6]) * v + a[ 5]) * v + a[ 4];
+    T b0 = ((a[ 3] * v + a[ 2]) * v + a[ 1]) * v + a[ 0];
+
+    return ((b3 * u + b2) * u + b1) * u + b0;
+}
+
+template<class T>
+void BiCubic<T>::Interpolate(const T *x_, const T *y_, const std::size_t n,
+    T *out) const {
+
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = Interpolate(x_[i], y_[i]);
+}
+
+template<class T>
+TriLinear<T>::TriLinear(const std::vector<T> &x_, const std::vector<T> &y_,
+    const std::vector<T> &z_, const std::vector<T> &data_){
+
+    const std::vector<T> *axes[3] = { &x_, &y_, &z_ };
+
+    for (int a = 0; a < 3; a++){
+
+        origin[a]  = axes[a] -> front();
+        inverse[a] = T(1) / Spacing(*axes[a], "TriLinear::TriLinear()");
+        size[a]    = axes[a] -> size();
+    }
+
+    if ( data_.size() != size[0] * size[1] * size[2] )
+    throw InterpError("From TriLinear::TriLinear(), the size of `data` "
+    "should equal the product of the sizes of the axes!");
+
+    data = data_;
+}
+
+template<class T>
+std::size_t TriLinear<T>::Cell(const int axis, const T &value,
+    T &fraction) const {
+
+    return Uniform(value, origin[axis], inverse[axis], size[axis], fraction);
+}
+
+template<class T>
+T TriLinear<T>::Interpolate(const T &x_, const T &y_, const T &z_) const {
+
+    T u, v, w;
+    std::size_t i = Cell(0, x_, u), j = Cell(1, y_, v), k = Cell(2, z_, w);
+
+    // the eight corners, the `x` neighbours are adjacent in memory
+    std::size_t nx = size[0], plane = size[0] * size[1];
+    const T *c = data.data() + k * plane + j * nx + i;
+
+    T c00 = c[0]          + u * (c[1]              - c[0]);
+    T c10 = c[nx]         + u * (c[nx + 1]         - c[nx]);
+    T c01 = c[plane]      + u * (c[plane + 1]      - c[plane]);
+    T c11 = c[plane + nx] + u * (c[plane + nx + 1] - c[plane + nx]);
+
+    T c0 = c00 + v * (c10 - c00);
+    T c1 = c01 + v * (c11 - c01);
+
+    return c0 + w * (c1 - c0);
+}
+
+template<class T>
+void TriLinear<T>::Interpolate(const T *x_, const T *y_, const T *z_,
+    const std::size_t n, T *out) const {
+
+    for (std::size_t i = 0; i < n; i++)
+        out[i] = Interpolate(x_[i], y_[i], z_[i]);
+}
+
+template<class T>
+void BiLinear<T>::Interpolate(const T *x_, const T *y_, const std::size_t n,
+    T *out, std::size_t *order) const {
+
+    if ( x.size() < 2 || y.size() < 2 )
+    throw InterpError("From BiLinear::Interpolate(), the grid needs at "
+    "least two values along each axis!");
+
+    // the interval along `x` of each pair is kept in `out` until the one
+    // along `y` is known
+    Locate(x, uniform[0], origin[0], inverse[0], x_, n, order,
+        [out](std::size_t k, std::size_t i){ out[k] = T(i); });
+
+    Locate(y, uniform[1], origin[1], inverse[1], y_, n, order,
+        [this, x_, y_, out](std::size_t k, std::size_t j){
+
+            std::size_t i = std::size_t(out[k]);
+            T t = (x_[k] - x[i-1]) / (x[i] - x[i-1]);
+
+            T R1 = z[j-1][i-1] + t * (z[j-1][i] - z[j-1][i-1]);
+            T R2 = z[j  ][i-1] + t * (z[j  ][i] - z[j  ][i-1]);
+
+            out[k] = R1 + (y_[k] - y[j-1]) * (R2 - R1) / (y[j] - y[j-1]); });
+}
+
 template class Linear<float>;
 template class Linear<double>;
 template class Linear<long double>;
@@ -174,6 +511,14 @@ template class BiLinear<float>;
 template class BiLinear<double>;
 template class BiLinear<long double>;
 
+template class BiCubic<float>;
+template class BiCubic<double>;
+template class BiCubic<long double>;
+
+template class TriLinear<float>;
+template class TriLinear<double>;
+template class TriLinear<long double>;
+
 } // namespace Interpolate
 
 } // namespace Gaia
@@ -3,18 +3,78 @@
 // Library/Main.cc
 //
 // This is the `main` source file for the project. It simply makes the call
-// to create the `Simulation` object and runs the code.
+// to create the `Simulation` object and runs the code. `gaia convert` exports
+// binary output files (or records of an archive) as text instead.
 
 #include <iostream>
 #include <exception>
+#include <string>
+#include <vector>
+#include <cstring>
 
 #include "../Include/Simulation.hpp"
+#include "../Include/BinaryFile.hpp"
+#include "../Include/Archive.hpp"
+#include "../Include/TextWriter.hpp"
 #include "../Include/Exception.hpp"
 
 int main( const int argc, const char *argv[] ){
 
 	try {
 
+		if ( argc > 1 && std::string(argv[1]) == "convert" ){
+
+			std::string usage =
+			"gaia convert <input.bin> [output.dat]\n\t"
+			"gaia convert <input.gar> [<kind> <trial> [output.dat]]\n\n\t"
+			"Export a binary position or separation file as text. The output\n\t"
+			"defaults to the input name with a `.dat` extension. For an archive\n\t"
+			"the index is listed, or the record for `kind` and `trial` exported.\n";
+
+			if ( argc < 3 ) throw Gaia::Usage(usage);
+			std::string input = argv[2];
+
+			if ( Gaia::Archive::IsArchive(input) ){
+
+				if ( argc == 3 ){
+
+					for ( const auto& entry : Gaia::Archive::Index(input) )
+						std::cout << std::string(entry.kind, strnlen(entry.kind, 8))
+						<< " " << entry.trial << " " << entry.dtype << " "
+						<< entry.offset << " " << entry.bytes << std::endl;
+
+					return 0;
+				}
+
+				if ( argc < 5 || argc > 6 ) throw Gaia::Usage(usage);
+
+				std::string kind  = argv[3];
+				std::string trial = argv[4];
+				std::string output = argc == 6 ? argv[5] :
+					input.substr(0, input.rfind(".gar")) + "-" + kind + "-" +
+					trial + ".dat";
+
+				std::vector< std::vector<double> > columns;
+				Gaia::BinaryFile::Header header = Gaia::Archive::Read(input,
+					kind, std::stoul(trial), columns);
+
+				std::vector<const double*> pointers;
+				for ( const auto& column : columns )
+					pointers.push_back( column.data() );
+
+				Gaia::TextWriter::Write(output, pointers, header.rows);
+				return 0;
+			}
+
+			if ( argc > 4 ) throw Gaia::Usage(usage);
+
+			std::string output = argc == 4 ? argv[3] :
+				input.substr(0, input.rfind(".bin")) + ".dat";
+
+			Gaia::BinaryFile::Convert(input, output);
+			return 0;
+		}
+
 		// create and run the simulation
 		Gaia::Simulation simulation(argc, argv);
 		simulation.Run();
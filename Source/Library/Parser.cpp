@@ -17,11 +17,13 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <algorithm>
 #include <omp.h>
 #include <stdlib.h>
 
 #include <Parser.hpp>
 #include <Exception.hpp>
+#include <VoxelCache.hpp>
 
 namespace Gaia {
 
@@ -51,10 +53,18 @@ void Parser::Setup(const int argc, const char *argv[]){
 
 	// display usage
 	if ( argc == 1 ) throw Usage(
-    "Gaia [--num-particles=] [--num-trials=] [--num-threads=] [--set-verbose=0|1|2|3]\n\t"
+    "Gaia [--num-particles=] [--num-trials=|auto] [--num-threads=] [--set-verbose=0|1|2|3]\n\t"
     "[--out-path=] [--raw-path=] [--map-path=] [--pos-path=] [--first-seed=]\n\t"
     "[--sample-rate=] [--mean-bandwidth=] [--stdev-bandwidth=] [--rc-file=]\n\t"
-    "[--no-analysis] [--keep-pos] [--keep-raw] [--debug]\n\n\t"
+    "[--cache-path=] [--format=text|bin|bin32|fits] [--no-analysis] [--keep-pos]\n\t"
+    "[--keep-raw] [--no-cache] [--async-io] [--io-buffer=] [--archive]\n\t"
+    "[--archive-path=] [--max-memory=] [--scratch-path=] [--pipeline]\n\t"
+    "[--build-threads=] [--parallel=particles|trials|auto] [--checkpoint]\n\t"
+    "[--checkpoint-path=] [--checkpoint-every=] [--resume] [--tolerance=]\n\t"
+    "[--max-trials=] [--proposals=mt|sobol|halton] [--qmc-restart]\n\t"
+    "[--no-sampler] [--voxel-cache] [--voxel-path=] [--voxel-resolution=]\n\t"
+    "[--voxel-tolerance=] [--reorder] [--interpolation=linear|cubic]\n\t"
+    "[--envelope] [--debug]\n\n\t"
     "An application for building 3D numerical models of systems of particles\n\t"
     "using a Monte Carlo rejection chain algorithm based on probability density\n\t"
     "functions (PDFs) defined by the user. A nearest neighbor analysis is \n\t"
@@ -84,7 +94,7 @@ void Parser::SetDefaults(){
 
 	// default arguments
 	argument["--num-particles"  ] = "~";   // necessarily reset
-	argument["--num-trials"     ] = "30";
+	argument["--num-trials"     ] = "30";  // or `auto` (until --tolerance)
 	argument["--num-threads"    ] = "1";
 	argument["--set-verbose"    ] = "2";
 	argument["--out-path"       ] = "Gaia-out-";
@@ -100,12 +110,51 @@ void Parser::SetDefaults(){
 	argument["--mean-bandwidth" ] = "0"; // must be assigned for analysis!
 	argument["--stdev-bandwidth"] = "0"; // defaults to --mean-bandwidth
 	argument["--debug"          ] = "0";
+	argument["--cache-path"     ] = "";  // next to profile data by default
+	argument["--no-cache"       ] = "0";
+	argument["--format"         ] = "text"; // for positions and separations
+	argument["--async-io"       ] = "0";
+	argument["--io-buffer"      ] = "512";  // MB queued for the writer thread
+	argument["--archive"        ] = "0";
+	argument["--archive-path"   ] = "Gaia-archive.gar";
+	argument["--max-memory"     ] = "0";  // MB, 0 means no limit
+	argument["--scratch-path"   ] = "Gaia-scratch-";
+	argument["--pipeline"       ] = "0";
+	argument["--build-threads"  ] = "0";  // half of --num-threads by default
+	argument["--parallel"       ] = "particles"; // trials or auto are opt-in
+	argument["--checkpoint"     ] = "0";
+	argument["--checkpoint-path"] = "Gaia-checkpoint.chk";
+	argument["--checkpoint-every"] = "1"; // trials between checkpoints
+	argument["--resume"         ] = "0";
+	argument["--tolerance"      ] = "1e-3"; // with `--num-trials auto`
+	argument["--max-trials"     ] = "100";
+	argument["--proposals"      ] = "mt"; // or a quasi-random `sobol`, `halton`
+	argument["--qmc-restart"    ] = "0";  // rescramble every trial
+	argument["--no-sampler"     ] = "0";  // always propose uniformly
+	argument["--voxel-cache"    ] = "0";
+	argument["--voxel-path"     ] = "Gaia-voxels.vox";
+	argument["--voxel-resolution"] = "64"; // voxels per side to begin with
+	argument["--voxel-tolerance"] = "0.01"; // of the largest density
+	argument["--reorder"        ] = "0";  // test the cheapest profiles first
+	argument["--interpolation"  ] = "linear"; // of 2D tables, or `cubic`
+	argument["--envelope"       ] = "0";  // (R, Z) table of the profiles
 
 	// arguments who don't need an assigment
 	implicit["--no-analysis"] = "~";
 	implicit["--keep-raw"   ] = "~";
 	implicit["--keep-pos"   ] = "~";
 	implicit["--debug"      ] = "~";
+	implicit["--no-cache"   ] = "~";
+	implicit["--async-io"   ] = "~";
+	implicit["--archive"    ] = "~";
+	implicit["--pipeline"   ] = "~";
+	implicit["--checkpoint" ] = "~";
+	implicit["--resume"     ] = "~";
+	implicit["--qmc-restart"] = "~";
+	implicit["--no-sampler" ] = "~";
+	implicit["--voxel-cache"] = "~";
+	implicit["--reorder"    ] = "~";
+	implicit["--envelope"   ] = "~";
 
 	// list values as `not given` before assignments
 	_given_xlims = _given_ylims  = _given_zlims = _given_analysis = false;
@@ -161,7 +210,8 @@ void Parser::ReadRC(){
 
 		// check that the first word is appropriate
 		//if ( Command.find(line[0]) == Command.end() ){
-		if ( line[0] != "set" && line[0] != "include" ){
+		if ( line[0] != "set" && line[0] != "include" &&
+			line[0] != "define" ){
 
 			std::stringstream warning;
 			warning << "In file `" << _rc_file << "` on line " << _line_number;
@@ -175,6 +225,8 @@ void Parser::ReadRC(){
 
 		if ( line[0] == "set" )
 			Set(line);
+		else if ( line[0] == "define" )
+			Define(line);
 		else
 			Include(line);
 	}
@@ -239,6 +291,7 @@ void Parser::Rectify(){
 	_map_path = argument["--map-path"];
 	_pos_path = argument["--pos-path"];
 	_rc_file  = argument["--rc-file" ];
+	_cache_path = argument["--cache-path"];
 
 	// replace `~` with `$HOME`
 	ReplaceAll("~", std::string(getenv("HOME")), _out_path);
@@ -246,6 +299,7 @@ void Parser::Rectify(){
 	ReplaceAll("~", std::string(getenv("HOME")), _map_path);
 	ReplaceAll("~", std::string(getenv("HOME")), _pos_path);
 	ReplaceAll("~", std::string(getenv("HOME")), _rc_file );
+	ReplaceAll("~", std::string(getenv("HOME")), _cache_path);
 
 	// giving `--raw-path` or `--pos-path` implicitely means `--keep-*`
 	_keep_raw = given["--raw-path"] || given["--keep-raw"] ? true : false;
@@ -290,11 +344,47 @@ void Parser::Rectify(){
 	// set threads
 	omp_set_num_threads(_num_threads);
 
-	// check trial numbers
+	// check trial numbers, `auto` runs up to --max-trials until converged
+	_auto_trials = argument["--num-trials"] == "auto";
 	convert.clear();
-	convert.str( argument["--num-trials"] );
+	convert.str( argument[ _auto_trials ? "--max-trials" : "--num-trials" ] );
 	if ( !( convert >> _num_trials ) || _num_trials < 1 )
-		throw InputError("--num-trials needs a postive integer value!");
+		throw InputError( _auto_trials ? "--max-trials needs a positive "
+		"integer value!" : "--num-trials needs a postive integer value "
+		"(or `auto`)!");
+
+	// target relative standard error of the pooled statistics
+	convert.clear();
+	convert.str( argument["--tolerance"] );
+	if ( !( convert >> _tolerance ) || _tolerance <= 0.0 )
+		throw InputError("--tolerance needs a positive value!");
+
+	// positions proposed by the Mersenne Twister or a quasi-random sequence
+	_proposals = argument["--proposals"];
+	if ( _proposals != "mt" && _proposals != "sobol" && _proposals != "halton" )
+		throw InputError("--proposals takes `mt`, `sobol` or `halton`!");
+	_restart = given["--qmc-restart"] ? true : false;
+	if ( _restart && _proposals == "mt" ) throw InputError("--qmc-restart "
+		"needs quasi-random --proposals (`sobol` or `halton`)!");
+
+	// profiles that can be sampled directly propose the positions
+	_sampler = given["--no-sampler"] ? false : true;
+
+	// axisymmetric profiles propose from a table of their product in (R, Z)
+	_envelope = given["--envelope"] ? true : false;
+	if ( _envelope && !_sampler ) throw InputError("--envelope proposes the "
+		"positions, it can't be used with --no-sampler!");
+	if ( _envelope && _proposals != "mt" ) throw InputError("--envelope "
+		"draws its own candidates, it can't be used with quasi-random "
+		"--proposals!");
+
+	// order the profiles by their measured cost and selectivity
+	_reorder = given["--reorder"] ? true : false;
+
+	// 2D tables are bilinear or bicubic surfaces
+	_interpolation = argument["--interpolation"];
+	if ( _interpolation != "linear" && _interpolation != "cubic" )
+		throw InputError("--interpolation takes `linear` or `cubic`!");
 
 	// ensure we have Xlimits from rc file
 	if ( !_given_xlims ) {
@@ -362,6 +452,94 @@ void Parser::Rectify(){
 
 	// check for `debug` mode
 	_debug_mode = given["--debug"] ? true : false;
+
+	// binary images of profile tables
+	_use_cache = given["--no-cache"] ? false : true;
+
+	// output format for positions and separations
+	_format = argument["--format"];
+	if ( _format != "text" && _format != "bin" && _format != "bin32" &&
+		_format != "fits" ) throw InputError("--format takes `text`, `bin` "
+		"(float64), `bin32` (float32) or `fits`!");
+
+	// background writer thread and the memory it may hold
+	_async_io = given["--async-io"] ? true : false;
+	convert.clear();
+	convert.str( argument["--io-buffer"] );
+	if ( !(convert >> as_double) || as_double <= 0 )
+		throw InputError("--io-buffer needs a positive size (in MB)!");
+	_io_buffer = as_double * 1024 * 1024;
+
+	// one indexed file for every trial (giving a path implies it)
+	_archive = given["--archive"] || given["--archive-path"] ? true : false;
+	_archive_path = argument["--archive-path"];
+	if ( _archive_path.empty() )
+		throw InputError("--archive-path cannot be empty!");
+
+	// populations larger than this are streamed through a scratch file
+	convert.clear();
+	convert.str( argument["--max-memory"] );
+	if ( !(convert >> as_double) || as_double < 0 )
+		throw InputError("--max-memory needs a positive size (in MB)!");
+	_max_memory = as_double * 1024 * 1024;
+	_scratch_path = argument["--scratch-path"];
+
+	// build the next trial during the analysis of this one, giving the
+	// number of threads for it implies it
+	_pipeline = given["--pipeline"] || given["--build-threads"] ? true : false;
+	convert.clear();
+	convert.str( argument["--build-threads"] );
+	if ( !(convert >> _build_threads) || _build_threads < 0 ||
+		_build_threads > _num_threads ) throw InputError("--build-threads "
+		"needs an integer between 1 and --num-threads!");
+	if ( !_build_threads ) _build_threads = std::max(1, _num_threads / 2);
+
+	// run whole trials per thread or split each trial over the threads
+	_parallel = argument["--parallel"];
+	if ( _parallel != "auto" && _parallel != "trials" &&
+		_parallel != "particles" ) throw InputError("--parallel takes "
+		"`particles`, `trials` or `auto`!");
+	if ( _parallel == "trials" && _pipeline ) throw InputError("--pipeline "
+		"overlaps the stages of a trial, it can't be used with "
+		"--parallel=trials!");
+
+	// save progress every so many trials, resuming keeps checkpointing
+	_resume = given["--resume"] ? true : false;
+	_checkpoint = _resume || given["--checkpoint"] ||
+		given["--checkpoint-path"] || given["--checkpoint-every"] ? true : false;
+	_checkpoint_path = argument["--checkpoint-path"];
+	if ( _checkpoint_path.empty() )
+		throw InputError("--checkpoint-path cannot be empty!");
+	convert.clear();
+	convert.str( argument["--checkpoint-every"] );
+	if ( !(convert >> _checkpoint_every) || _checkpoint_every < 1 )
+		throw InputError("--checkpoint-every needs a positive number of "
+		"trials!");
+
+	// the product of the profiles on a grid (giving a path implies it), it is
+	// only kept on disk with the profile images
+	_voxel_cache = given["--voxel-cache"] || given["--voxel-path"] ||
+		given["--voxel-resolution"] || given["--voxel-tolerance"] ? true : false;
+	_voxel_path = argument["--voxel-path"];
+	if ( _voxel_path.empty() )
+		throw InputError("--voxel-path cannot be empty!");
+	if ( !_use_cache ) _voxel_path = "";
+	convert.clear();
+	convert.str( argument["--voxel-resolution"] );
+	if ( !(convert >> as_double) || as_double < 1 ||
+		as_double * as_double * as_double > VOXEL_MAX_CELLS )
+		throw InputError("--voxel-resolution needs a positive integer (at "
+		"most 256)!");
+	_voxel_resolution = as_double;
+	convert.clear();
+	convert.str( argument["--voxel-tolerance"] );
+	if ( !(convert >> _voxel_tolerance) || _voxel_tolerance <= 0.0 )
+		throw InputError("--voxel-tolerance needs a positive value!");
+	if ( _voxel_cache && _proposals != "mt" ) throw InputError("The "
+		"--voxel-cache draws its own candidates, it can't be used with "
+		"quasi-random --proposals!");
+	if ( _voxel_cache && _envelope ) throw InputError("--voxel-cache and "
+		"--envelope both draw the candidates, give only one of them!");
 }
 
 void Parser::Set(const std::vector<std::string> &line){
@@ -605,6 +783,32 @@ void Parser::Include(const std::vector<std::string> &line){
 	}
 }
 
+void Parser::Define(const std::vector<std::string> &line){
+
+	//
+	// Parse a line of text from the RC-file that `define`s an analytical
+	// profile by an expression (compiled by the ProfileManager)
+	//
+
+	if ( line.size() != 3 ){
+
+		std::stringstream warning;
+		warning << "In file `" << _rc_file << "` on line " << _line_number;
+		warning << ", `define` takes a name and an expression (in quotes)!";
+		throw InputError( warning.str() );
+	}
+
+	if ( DefinedPDFs.find( line[1] ) != DefinedPDFs.end() ){
+
+		std::stringstream warning;
+		warning << "In file `" << _rc_file << "` on line " << _line_number;
+		warning << ", the profile `" << line[1] << "` was already defined!";
+		throw InputError( warning.str() );
+	}
+
+	DefinedPDFs[ line[1] ] = line[2];
+}
+
 // remove all characters after `delim`
 void Parser::Clip(std::string &input_string, const std::string &delim){
 
@@ -733,6 +937,118 @@ std::string Parser::GetRCFile() const {
 	return _rc_file;
 }
 
+std::string Parser::GetCachePath() const {
+	return _cache_path;
+}
+
+bool Parser::GetCacheFlag() const {
+	return _use_cache;
+}
+
+std::string Parser::GetFormat() const {
+	return _format;
+}
+
+bool Parser::GetAsyncFlag() const {
+	return _async_io;
+}
+
+std::size_t Parser::GetIOBuffer() const {
+	return _io_buffer;
+}
+
+bool Parser::GetArchiveFlag() const {
+	return _archive;
+}
+
+std::string Parser::GetArchivePath() const {
+	return _archive_path;
+}
+
+std::size_t Parser::GetMaxMemory() const {
+	return _max_memory;
+}
+
+std::string Parser::GetScratchPath() const {
+	return _scratch_path;
+}
+
+bool Parser::GetPipelineFlag() const {
+	return _pipeline;
+}
+
+int Parser::GetBuildThreads() const {
+	return _build_threads;
+}
+
+std::string Parser::GetParallelMode() const {
+	return _parallel;
+}
+
+bool Parser::GetCheckpointFlag() const {
+	return _checkpoint;
+}
+
+std::string Parser::GetCheckpointPath() const {
+	return _checkpoint_path;
+}
+
+int Parser::GetCheckpointEvery() const {
+	return _checkpoint_every;
+}
+
+bool Parser::GetResumeFlag() const {
+	return _resume;
+}
+
+bool Parser::GetAutoTrialsFlag() const {
+	return _auto_trials;
+}
+
+double Parser::GetTolerance() const {
+	return _tolerance;
+}
+
+std::string Parser::GetProposals() const {
+	return _proposals;
+}
+
+bool Parser::GetRestartFlag() const {
+	return _restart;
+}
+
+bool Parser::GetSamplerFlag() const {
+	return _sampler;
+}
+
+bool Parser::GetEnvelopeFlag() const {
+	return _envelope;
+}
+
+bool Parser::GetReorderFlag() const {
+	return _reorder;
+}
+
+std::string Parser::GetInterpolation() const {
+	return _interpolation;
+}
+
+bool Parser::GetVoxelFlag() const {
+	return _voxel_cache;
+}
+
+std::string Parser::GetVoxelPath() const {
+	return _voxel_path;
+}
+
+std::size_t Parser::GetVoxelResolution() const {
+	return _voxel_resolution;
+}
+
+double Parser::GetVoxelTolerance() const {
+	return _voxel_tolerance;
+}
+
 unsigned long long Parser::GetFirstSeed() const {
 	return _first_seed;
 }
@@ -753,4 +1069,8 @@ std::map<std::string, std::string> Parser::GetUsedPDFs() const {
 	return UsedPDFs;
 }
 
+std::map<std::string, std::string> Parser::GetDefinedPDFs() const {
+	return DefinedPDFs;
+}
+
 } // namespace Gaia
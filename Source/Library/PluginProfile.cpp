@@ -0,0 +1,146 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/PluginProfile.cc
+//
+// Source file for the `PluginProfile` class. See Include/PluginProfile.hpp.
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+
+#include <PluginProfile.hpp>
+#include <Exception.hpp>
+#include <Parser.hpp>
+
+namespace Gaia {
+
+namespace {
+
+// what the `sample` hook draws its random numbers from
+struct Source {
+	ParallelMT *source;
+	int thread;
+};
+
+double Uniform(void *context){
+
+	Source *from = static_cast<Source*>(context);
+	return from -> source -> RandomReal(from -> thread);
+}
+
+} // anonymous namespace
+
+PluginProfile::PluginProfile(const std::string &name,
+	const std::string &library, const std::string &argument):
+	ProfileBase(name), _handle(nullptr), _inverse(1.0) {
+
+	std::memset(&_plugin, 0, sizeof(GaiaPlugin));
+
+	_handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+	if ( !_handle ) throw ProfileError("I couldn't load the plugin `" +
+		library + "` (" + dlerror() + ")!");
+
+	GaiaRegister Register = reinterpret_cast<GaiaRegister>(
+		dlsym(_handle, "gaia_register"));
+
+	if ( !Register ){
+
+		dlclose(_handle);
+		throw ProfileError("The plugin `" + library + "` doesn't export "
+			"`gaia_register`!");
+	}
+
+	Parser *parser = Parser::GetInstance();
+	std::vector<double> X = parser -> GetXlimits();
+	std::vector<double> Y = parser -> GetYlimits();
+	std::vector<double> Z = parser -> GetZlimits();
+	double limits[6] = { X[0], X[1], Y[0], Y[1], Z[0], Z[1] };
+
+	const char *message = nullptr;
+	int refused = Register(&_plugin, limits, argument.c_str(), &message);
+
+	std::string problem = refused ? std::string("it refused") + ( message ?
+		" (" + std::string(message) + ")" : "" ) :
+		_plugin.version != GAIA_PLUGIN_VERSION ? "its version doesn't match "
+		"this Gaia" : !_plugin.evaluate ? "it gave no `evaluate`" : "";
+
+	if ( !problem.empty() ){
+
+		if ( !refused && _plugin.release ) _plugin.release(_plugin.state);
+		dlclose(_handle);
+		throw ProfileError("The plugin `" + library + "` couldn't be used, " +
+			problem + "!");
+	}
+
+	_description = _plugin.name ? _plugin.name : library;
+
+	switch ( _plugin.symmetry ){
+
+		case GAIA_SYMMETRY_AXISYMMETRIC: symmetry = AXISYMMETRIC; break;
+		case GAIA_SYMMETRY_SPHERICAL:    symmetry = SPHERICAL;    break;
+		case GAIA_SYMMETRY_PLANAR:       symmetry = PLANAR;       break;
+		default:                         symmetry = NONE;
+	}
+
+	// the largest density becomes (about) 1
+	if ( _plugin.bound ){
+
+		double bound = _plugin.bound(_plugin.state);
+
+		if ( !(bound > 0.0) || !std::isfinite(bound) ){
+
+			if ( _plugin.release ) _plugin.release(_plugin.state);
+			dlclose(_handle);
+			throw ProfileError("The plugin `" + library + "` gave a bound "
+				"that isn't positive!");
+		}
+
+		_inverse = 1.0 / bound;
+	}
+}
+
+PluginProfile::~PluginProfile(){
+
+	if ( _plugin.release ) _plugin.release(_plugin.state);
+	if ( _handle ) dlclose(_handle);
+}
+
+double PluginProfile::Function(const Point &point){
+
+	return _inverse * _plugin.evaluate(_plugin.state, point.X(), point.Y(),
+		point.Z());
+}
+
+void PluginProfile::Batch(const double *x, const double *y, const double *z,
+	const std::size_t n, double *out){
+
+	if ( !_plugin.batch ){
+
+		ProfileBase::Batch(x, y, z, n, out);
+		return;
+	}
+
+	_plugin.batch(_plugin.state, x, y, z, n, out);
+
+	if ( _inverse != 1.0 ){
+
+		#pragma omp simd
+		for ( std::size_t i = 0; i < n; i++ )
+			out[i] *= _inverse;
+	}
+}
+
+Vector PluginProfile::Sample(ParallelMT *source, const int thread){
+
+	Source from = { source, thread };
+	double position[3];
+
+	_plugin.sample(_plugin.state, Uniform, &from, position);
+
+	return Vector(position[0], position[1], position[2]);
+}
+
+} // namespace Gaia
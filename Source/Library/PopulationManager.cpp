@@ -8,6 +8,11 @@
 
 #include <fstream>
 #include <cmath>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <PopulationManager.hpp>
 #include <ProfileManager.hpp>
@@ -17,11 +22,24 @@
 #include <Vector.hpp>
 #include <Parser.hpp>
 #include <Random.hpp>
+#include <Checkpoint.hpp>
 
 #ifndef pi
 #define pi 3.141592653589793
 #endif
 
+// with `--parallel=auto` whole trials run concurrently up to this many
+// particles, beyond it the regions within a trial are long enough
+#define TRIAL_PARALLEL_N 50000
+
+// `--num-trials auto` runs at least this many trials
+#define MIN_AUTO_TRIALS 3
+
+// positions drawn per call by Populate(), and candidates per block when
+// the profiles are evaluated in batches
+#define DRAW_CHUNK 4096
+#define DRAW_BLOCK 256
+
 namespace Gaia {
 
 PopulationManager::PopulationManager(){
@@ -29,6 +47,14 @@ PopulationManager::PopulationManager(){
 	// initialize pointers to nullptr
 	profiles  = nullptr;
 	generator = nullptr;
+	proposals = nullptr;
+	envelope  = nullptr;
+	voxels    = nullptr;
+	buckets   = nullptr;
+	marked    = false;
+	batched   = false;
+	converged = false;
+	completed = 0;
 }
 
 PopulationManager::~PopulationManager()
@@ -46,6 +72,38 @@ PopulationManager::~PopulationManager()
 		delete generator;
 		generator = nullptr;
 	}
+
+	// delete quasi-random proposals
+	if (proposals)
+	{
+		delete proposals;
+		proposals = nullptr;
+	}
+
+	// delete the (R, Z) table
+	if (envelope)
+	{
+		delete envelope;
+		envelope = nullptr;
+	}
+
+	// delete the grid of the profiles
+	if (voxels)
+	{
+		delete voxels;
+		voxels = nullptr;
+	}
+
+	// a background build still running (after an error)
+	if (builder.joinable())
+		builder.join();
+
+	// removes the scratch file
+	if (buckets)
+	{
+		delete buckets;
+		buckets = nullptr;
+	}
 }
 
 // set up the `Profile`s
@@ -84,13 +142,170 @@ void PopulationManager::Initialize(){
 	// initialize parallel mt19937 PRNG array
 	generator = new ParallelMT(threads, first_seed);
 
-	// initialize `positions` vector
-	std::vector<Vector> new_population_vector;
-	positions = new_population_vector;
-	positions.resize(N);
+	// a block of the sequence per thread
+	sequence    = parser -> GetProposals() == "halton" ? QuasiRandom::HALTON :
+		QuasiRandom::SOBOL;
+	qmc_restart = parser -> GetRestartFlag();
+	if ( parser -> GetProposals() != "mt" )
+		proposals = new QuasiRandom(sequence, threads, first_seed);
+
+	if ( parser -> GetVoxelFlag() ){
+
+		// the image is stale if any of the profile tables changed, or if
+		// this executable was rebuilt (the compiled profiles may differ)
+		std::stringstream key;
+
+		struct stat build;
+		if ( !stat("/proc/self/exe", &build) )
+			key << build.st_size << ' ' << build.st_mtime << ' ';
+		for ( const auto& pdf : parser -> GetUsedPDFs() ){
+
+			key << pdf.first << ' ' << pdf.second << ' ';
+
+			struct stat info;
+			if ( !pdf.second.empty() && !stat(pdf.second.c_str(), &info) )
+				key << info.st_size << ' ' << info.st_mtime << ' ';
+
+			if ( !pdf.first.compare(0, 7, "plugin:") &&
+				!stat(pdf.first.substr(7).c_str(), &info) )
+				key << info.st_size << ' ' << info.st_mtime << ' ';
+		}
+
+		for ( const auto& pdf : parser -> GetDefinedPDFs() )
+			key << pdf.first << ' ' << pdf.second << ' ';
+
+		key << parser -> GetInterpolation();
 
-	// build intervals on `positions` vector
-	interval = Interval::Build(positions, threads);
+		if ( verbose ) std::cout << "\n Preparing the voxel cache ..."
+			<< std::endl;
+
+		voxels = new VoxelCache(profiles -> UsedPDFs, Xlimits, Ylimits,
+			Zlimits, parser -> GetVoxelResolution(),
+			parser -> GetVoxelTolerance(), key.str(),
+			parser -> GetVoxelPath(), profiles -> Chain);
+
+		if ( verbose ) std::cout << " " << ( voxels -> Loaded() ? "Read" :
+			"Computed" ) << " " << voxels -> Resolution() << "^3 voxels "
+			"(relative error " << voxels -> Error() << ")" << std::endl;
+	}
+
+	// with `--envelope` (a single profile with its own sampler needs none)
+	else if ( parser -> GetEnvelopeFlag() && profiles -> Axisymmetric() &&
+		!( profiles -> Sampler && profiles -> UsedPDFs.size() == 1 ) ){
+
+		envelope = new Envelope(profiles -> UsedPDFs, Xlimits, Ylimits, Zlimits,
+			profiles -> Chain);
+
+		if ( verbose ) std::cout << "\n Sampling from an (R, Z) table of the "
+			"profiles (efficiency " << envelope -> Efficiency() << ")"
+			<< std::endl;
+	}
+
+	// tables test their own product, otherwise the profiles are tested in
+	// turn and the cheapest, most selective ones should go first (a compiled
+	// chain keeps its own order)
+	if ( parser -> GetReorderFlag() && !voxels && !envelope &&
+		!profiles -> Chain ){
+
+		double given, chosen;
+		profiles -> Reorder(given, chosen);
+
+		if ( verbose ){
+
+			std::cout << "\n Testing the profiles in the order";
+			for ( const auto& pdf : profiles -> UsedPDFs )
+				if ( pdf != profiles -> Sampler )
+					std::cout << " " << pdf -> Name();
+
+			std::cout << "\n (" << chosen * 1e6 << " us per candidate, "
+				<< ( given > 0.0 ? 100.0 * (1.0 - chosen / given) : 0.0 )
+				<< "% less than the given order)" << std::endl;
+		}
+	}
+
+	// defined profiles evaluate blocks of candidates
+	batched = !voxels && !envelope && !profiles -> Chain &&
+		profiles -> Batched();
+
+	checkpoint       = parser -> GetCheckpointFlag();
+	checkpoint_every = parser -> GetCheckpointEvery();
+	checkpoint_path  = parser -> GetCheckpointPath();
+
+	// adaptive number of trials
+	auto_trials = parser -> GetAutoTrialsFlag();
+	tolerance   = parser -> GetTolerance();
+
+	if ( auto_trials && !analysis ) throw InputError("--num-trials auto "
+		"stops on the precision of the analysis, it can't be used with "
+		"--no-analysis!");
+
+	// stream through a scratch file if the population doesn't fit
+	std::size_t max_memory = parser -> GetMaxMemory();
+	streaming = max_memory && N * 3 * sizeof(double) + samples *
+		sizeof(double) > max_memory;
+
+	// initialize the `positions`
+	positions.resize(streaming ? samples : N);
+
+	// build intervals on the whole population
+	interval = Interval::Build(N, threads);
+
+	// run independent trials concurrently instead of splitting each one, only
+	// when asked since each trial then draws from its own substream and the
+	// population differs from the one `particles` gives for the same seed
+	std::string mode = parser -> GetParallelMode();
+	trial_parallel = mode == "trials" || ( mode == "auto" && threads > 1 &&
+		trials >= threads && N <= TRIAL_PARALLEL_N && verbose < 3 &&
+		!parser -> GetPipelineFlag() );
+
+	if ( trial_parallel && streaming ){
+
+		if ( mode == "trials" ) throw InputError("--parallel=trials keeps a "
+			"population per thread, it can't be used when the population is "
+			"larger than --max-memory!");
+
+		trial_parallel = false;
+	}
+
+	// the bounds of the (R, Z) table are raised between populations
+	if ( trial_parallel && envelope ){
+
+		if ( mode == "trials" ) throw InputError("--parallel=trials draws "
+			"several populations at once, it can't be used with --envelope!");
+
+		trial_parallel = false;
+	}
+
+	if ( streaming ){
+
+		// the samples, their separations, coordinates and search order
+		std::size_t resident = samples * (sizeof(Vector) + 5 * sizeof(double));
+
+		std::size_t minimum = resident + BucketFile::BucketSize(0) *
+			sizeof(BucketFile::Record);
+
+		if ( minimum > max_memory ){
+
+			std::stringstream warning;
+			warning << "--max-memory is too small, with this sample rate ";
+			warning << "at least " << minimum / 1024.0 / 1024.0 << " MB are ";
+			warning << "needed (or lower --sample-rate)!";
+			throw InputError( warning.str() );
+		}
+
+		if ( parser -> GetKeepPosFlag() ) throw InputError("--keep-pos needs "
+			"the whole population in memory, it can't be used when the "
+			"population is larger than --max-memory!");
+
+		std::stringstream scratch;
+		scratch << parser -> GetScratchPath() << getpid() << ".tmp";
+
+		buckets = new BucketFile(scratch.str(), Xlimits, Ylimits, Zlimits, N,
+			max_memory - resident);
+
+		// a batch and its sorted copy share the same budget
+		batch = (max_memory - resident) / (2 * sizeof(BucketFile::Record));
+	}
 
 	// compute the `span` of the space
 	Vector span(
@@ -146,6 +361,20 @@ void PopulationManager::Initialize(){
 	// save map information to file
 	file -> SaveMap( Axis );
 
+	if ( auto_trials ){
+
+		std::size_t cells = resolution.size() == 1 ? resolution[0] :
+			resolution[0] * resolution[1];
+
+		sums.assign(2 * cells, 0.0);
+		squares.assign(2 * cells, 0.0);
+
+		// the convergence of each trial is logged here (continued on resume)
+		convergence_path = parser -> GetOutPath() + "convergence.dat";
+		if ( !parser -> GetResumeFlag() )
+			std::ofstream(convergence_path.c_str(), std::ios::trunc);
+	}
+
 	if (resolution.size() == 1){
 		//FIXME: pooled mean/variance 1D initialization
 
@@ -165,15 +394,6 @@ void PopulationManager::Initialize(){
 		pooled_mean_2D = init_2D;
 		pooled_variance_2D = init_2D;
 	}
-
-	// build coordinate function map for transposing `positions`
-	Coord["X"] = X;
-	Coord["Y"] = Y;
-	Coord["Z"] = Z;
-	Coord["R"] = R;
-	Coord["Rho"] = Rho;
-	Coord["Phi"] = Phi;
-	Coord["Theta"] = Theta;
 }
 
 // build a new population set
@@ -183,55 +403,383 @@ void PopulationManager::Build(const int trial){
 		<< "\n --------------------------------------------------"
 		<< "\n Building population #" << trial + 1 << std::endl;
 
-	#pragma omp parallel for
+	if ( proposals && qmc_restart )
+		proposals -> Restart(trial);
+
+	// drawn again if the (R, Z) table fell short of the profiles
+	do {
+
+		if ( streaming ) Stream();
+		else Populate(positions, verbose > 2);
+
+	} while ( Redraw() );
+
+    if (verbose > 2)
+        display -> Progress(N, N);
+
+	// save results
+	if ( parser -> GetKeepPosFlag() )
+		file -> SavePositions(positions, trial + 1);
+}
+
+// draw a whole population into the scratch file (and its samples)
+void PopulationManager::Stream(){
+
+	//
+	// Each thread draws the same positions (with the same generator and
+	// index) as it would in memory, a batch at a time, so the results
+	// don't depend on the memory budget.
+	//
+
+	buckets -> Reset();
+	leftover.assign(threads, PositionArray());
+
+	std::vector<std::size_t> next(threads);
 	for (int i = 0; i < threads; i++)
-	for (std::size_t j = interval[i].start; j <= interval[i].end; j++){
+		next[i] = interval[i].start;
 
-        if ( verbose > 2 && !omp_get_thread_num() )
-            display -> Progress(j, N, omp_get_num_threads() );
+	std::size_t share = std::max<std::size_t>(1, batch / threads);
+	std::vector<BucketFile::Record> records;
+	std::vector<std::size_t> filled(threads);
 
-		// keep generating positions until we are `successful`
-		while ( true ){
+	for (std::size_t done = 0; done < N; ){
 
-			// flag for determining condition for a `break`
-			bool successful = true;
+		records.resize(share * threads);
 
-			// the new position vector (uniform in the `box`)
-			Vector new_position(
-				generator -> RandomReal( i, Xlimits ),
-				generator -> RandomReal( i, Ylimits ),
-				generator -> RandomReal( i, Zlimits ));
+		#pragma omp parallel for
+		for (int i = 0; i < threads; i++){
 
-			// loop through PDFs and reject if less than uniform random number
-			for ( const auto& pdf : profiles -> UsedPDFs ){
+			std::size_t count = next[i] > interval[i].end ? 0 :
+				std::min(share, interval[i].end + 1 - next[i]);
 
-				ProfileBase *this_pdf = pdf;
+			PositionArray drawn(count);
+			DrawMany(generator, proposals, i, drawn, 0, count, &leftover[i]);
 
-				if ( this_pdf -> Evaluate(new_position) <
-					generator -> RandomReal(i) ){
+			for (filled[i] = 0; filled[i] < count; filled[i]++){
 
-					successful = false;
-					break;
-				}
-			}
+				std::size_t j = next[i] + filled[i];
+				const Vector new_position = drawn[filled[i]];
 
-			if (successful) {
+				// the samples are the first positions
+				if ( j < samples ) positions.Set(j, new_position);
 
-				// keep the new position vector
-				positions[j] = new_position;
-				break;
+				BucketFile::Record &record = records[i * share + filled[i]];
+				record.x  = new_position.X();
+				record.y  = new_position.Y();
+				record.z  = new_position.Z();
+				record.id = j;
 			}
+
+			next[i] += filled[i];
 		}
+
+		// close the gaps left by threads that finished early
+		std::size_t count = 0;
+		for (int i = 0; i < threads; i++)
+		for (std::size_t k = 0; k < filled[i]; k++)
+			records[count++] = records[i * share + k];
+
+		records.resize(count);
+		buckets -> Append(records);
+		done += count;
+
+		if ( verbose > 2 )
+			display -> Progress(done, N);
 	}
+}
 
-    if (verbose > 2)
-        display -> Progress(N, N);
+// draw a whole population into `population` (in memory)
+void PopulationManager::Populate(PositionArray &population,
+	const bool progress){
+
+	leftover.assign(threads, PositionArray());
+
+	#pragma omp parallel for
+	for (int i = 0; i < threads; i++)
+	for (std::size_t j = interval[i].start; j <= interval[i].end;
+		j += DRAW_CHUNK){
+
+		if ( progress && !omp_get_thread_num() )
+			display -> Progress(j, N, omp_get_num_threads() );
+
+		// keep the new position vectors
+		DrawMany(generator, proposals, i, population, j,
+			std::min<std::size_t>(DRAW_CHUNK, interval[i].end + 1 - j),
+			&leftover[i]);
+	}
+}
+
+bool PopulationManager::Redraw(){
+
+	if ( !envelope ) return false;
+
+	std::size_t exceeded = envelope -> Raise();
+	if ( !exceeded ) return false;
+
+	std::cout << "\n Warning: the (R, Z) table fell short of the profiles at "
+		<< exceeded << " position(s), its bounds there were raised and the "
+		"population is drawn again" << std::endl;
+
+	return true;
+}
+
+void PopulationManager::BuildAhead(const int trial, const int build_threads){
+
+	//
+	// Draw population `trial` into the spare buffer on a separate thread
+	// with `build_threads` OpenMP threads. The generators are only used
+	// here, in trial order, so the populations are the same as in serial.
+	//
+
+	if ( verbose > 2 ) std::cout
+		<< "\n Building population #" << trial + 1 << " in the background"
+		<< std::endl;
+
+	spare.resize(N);
+	ahead_error = nullptr;
+
+	if ( checkpoint ){
+
+		rng_mark = GetStreams();
+		marked   = true;
+	}
+
+	if ( proposals && qmc_restart )
+		proposals -> Restart(trial);
+
+	builder = std::thread([this, build_threads](){
+
+		omp_set_num_threads(build_threads);
+
+		try { do Populate(spare, false); while ( Redraw() ); }
+		catch (...) { ahead_error = std::current_exception(); }
+	});
+}
+
+void PopulationManager::Advance(const int trial){
+
+	// wait for the background build, it becomes the current population
+	if ( builder.joinable() ) builder.join();
+	if ( ahead_error ) std::rethrow_exception(ahead_error);
+
+	marked = false;
+
+	// the last trial was enough, this one is never analyzed
+	if ( converged ) return;
+
+	positions.swap(spare);
 
 	// save results
 	if ( parser -> GetKeepPosFlag() )
 		file -> SavePositions(positions, trial + 1);
 }
 
+// a candidate from the sampler, `quasi` or uniformly in the `box` (false if
+// the sampler missed the `box`)
+bool PopulationManager::Propose(ParallelMT *source, QuasiRandom *quasi,
+	const int thread, Vector &candidate){
+
+	const int i = thread;
+
+	if ( profiles -> Sampler ){
+
+		candidate = profiles -> Sampler -> Propose(source, i);
+
+		// the sampler covers more than the `box`
+		return candidate.X() >= Xlimits[0] && candidate.X() <= Xlimits[1] &&
+			candidate.Y() >= Ylimits[0] && candidate.Y() <= Ylimits[1] &&
+			candidate.Z() >= Zlimits[0] && candidate.Z() <= Zlimits[1];
+
+	} else if ( quasi ){
+
+		double u[3];
+		quasi -> Next(i, u);
+
+		candidate = Vector(
+			Xlimits[0] + (Xlimits[1] - Xlimits[0]) * u[0],
+			Ylimits[0] + (Ylimits[1] - Ylimits[0]) * u[1],
+			Zlimits[0] + (Zlimits[1] - Zlimits[0]) * u[2]);
+
+	} else candidate = Vector(
+		source -> RandomReal( i, Xlimits ),
+		source -> RandomReal( i, Ylimits ),
+		source -> RandomReal( i, Zlimits ));
+
+	return true;
+}
+
+// `count` positions into `out` from position `first`, see Draw()
+void PopulationManager::DrawMany(ParallelMT *source, QuasiRandom *quasi,
+	const int thread, PositionArray &out, const std::size_t first,
+	const std::size_t count, PositionArray *rest){
+
+	if ( !batched ){
+
+		for ( std::size_t j = 0; j < count; j++ )
+			out.Set(first + j, Draw(source, quasi, thread));
+
+		return;
+	}
+
+	//
+	// A block of candidates is proposed at once, and each profile in turn
+	// is evaluated on those still standing (as arrays of X, Y and Z) and
+	// tested as in Draw(). The candidates left over when `out` is full go
+	// to `rest`, and are the first ones out of the next call.
+	//
+
+	const int i = thread;
+	ProfileBase *sampler = profiles -> Sampler;
+
+	std::size_t filled = 0;
+
+	if ( rest ){
+
+		std::size_t kept = rest -> size();
+
+		for ( ; filled < count && filled < kept; filled++ )
+			out.Set(first + filled, (*rest)[filled]);
+
+		for ( std::size_t k = filled; k < kept; k++ )
+			rest -> Set(k - filled, (*rest)[k]);
+
+		rest -> resize(kept - filled);
+	}
+
+	std::vector<double> x(DRAW_BLOCK), y(DRAW_BLOCK), z(DRAW_BLOCK);
+	std::vector<double> value(DRAW_BLOCK);
+
+	while ( filled < count ){
+
+		std::size_t n = 0;
+
+		for ( std::size_t k = 0; k < DRAW_BLOCK; k++ ){
+
+			Vector candidate;
+			if ( !Propose(source, quasi, i, candidate) ) continue;
+
+			x[n] = candidate.X();
+			y[n] = candidate.Y();
+			z[n] = candidate.Z();
+			n++;
+		}
+
+		for ( const auto& pdf : profiles -> UsedPDFs ){
+
+			if ( pdf == sampler || !n ) continue;
+
+			pdf -> Batch(x.data(), y.data(), z.data(), n, value.data());
+
+			std::size_t kept = 0;
+			for ( std::size_t k = 0; k < n; k++ ){
+
+				if ( value[k] < source -> RandomReal(i) ) continue;
+
+				x[kept] = x[k];
+				y[kept] = y[k];
+				z[kept] = z[k];
+				kept++;
+			}
+
+			n = kept;
+		}
+
+		std::size_t k = 0;
+		for ( ; k < n && filled < count; k++, filled++ )
+			out.Set(first + filled, x[k], y[k], z[k]);
+
+		if ( rest && k < n ){
+
+			rest -> resize(n - k);
+
+			for ( std::size_t m = 0; k < n; k++, m++ )
+				rest -> Set(m, x[k], y[k], z[k]);
+		}
+	}
+}
+
+// draw positions with generator `thread` of `source` until one is accepted
+Vector PopulationManager::Draw(ParallelMT *source, QuasiRandom *quasi,
+	const int thread){
+
+	const int i = thread;
+
+	// a profile that proposes the positions is not tested again
+	ProfileBase *sampler = profiles -> Sampler;
+
+	// keep generating positions until we are `successful`
+	while ( true ){
+
+		if ( voxels ){
+
+			// the bound of a voxel is its largest corner, so this accepts
+			// exactly by the interpolation
+			double bound;
+			Vector candidate = voxels -> Sample(source, i, bound);
+
+			if ( voxels -> Evaluate(candidate) < bound * source ->
+				RandomReal(i) ) continue;
+
+			return candidate;
+		}
+
+		if ( envelope ){
+
+			double bound;
+			std::size_t cell;
+			Vector candidate = envelope -> Sample(source, i, bound, cell);
+
+			// the table covers a cylinder around the `box`
+			if ( candidate.X() < Xlimits[0] || candidate.X() > Xlimits[1] ||
+				candidate.Y() < Ylimits[0] || candidate.Y() > Ylimits[1] )
+				continue;
+
+			double product = envelope -> Evaluate(candidate);
+			if ( product > bound ) envelope -> Exceeded(cell, product);
+
+			if ( product < bound * source -> RandomReal(i) ) continue;
+
+			return candidate;
+		}
+
+		// flag for determining condition for a `break`
+		bool successful = true;
+
+		// the new position vector (uniform in the `box`)
+		Vector new_position;
+		if ( !Propose(source, quasi, i, new_position) ) continue;
+
+		// the profiles share its derived coordinates
+		Point candidate(new_position);
+
+		// the same tests, compiled into one function
+		if ( profiles -> Chain ){
+
+			if ( profiles -> Chain -> Accept(candidate, source, i, sampler) )
+				return new_position;
+
+			continue;
+		}
+
+		// loop through PDFs and reject if less than uniform random number
+		for ( const auto& pdf : profiles -> UsedPDFs ){
+
+			ProfileBase *this_pdf = pdf;
+
+			if ( this_pdf == sampler ) continue;
+
+			if ( this_pdf -> Evaluate(candidate) <
+				source -> RandomReal(i) ){
+
+				successful = false;
+				break;
+			}
+		}
+
+		if (successful) return new_position;
+	}
+}
+
 // solve for the nearest neighbor seperations
 void PopulationManager::FindNeighbors(const int trial){
 
@@ -242,21 +790,10 @@ void PopulationManager::FindNeighbors(const int trial){
     std::vector<double> init(samples, max_seperation);
     seperations = init;
 
-    #pragma omp parallel for
-    for (std::size_t i = 0; i < samples; i++) {
-
-        if ( verbose > 2 && !omp_get_thread_num() )
-            display -> Progress(i, samples, omp_get_num_threads() );
+    // visit the buckets around each sample in the scratch file
+    if ( streaming ) buckets -> Nearest(positions, seperations);
 
-        for (std::size_t j = 0; j < N; j++)
-        if ( i != j ){
-
-            double r = (positions[i] - positions[j]).Mag();
-
-            if ( r < seperations[i] )
-                seperations[i] = r;
-        }
-    }
+    else Separations(positions, seperations, verbose > 2);
 
     if ( verbose > 2 )
         display -> Progress(N, N);
@@ -266,6 +803,166 @@ void PopulationManager::FindNeighbors(const int trial){
         file -> SaveRaw(seperations, trial + 1);
 }
 
+// nearest neighbor distances of the first samples of `population`
+void PopulationManager::Separations(const PositionArray &population,
+    std::vector<double> &result, const bool progress){
+
+    #pragma omp parallel for
+    for (std::size_t i = 0; i < result.size(); i++) {
+
+        if ( progress && !omp_get_thread_num() )
+            display -> Progress(i, result.size(), omp_get_num_threads() );
+
+        // the square root of the nearest (squared) distance is the nearest
+        double r = std::sqrt( population.Nearest(i, 0, population.size()) );
+
+        if ( r < result[i] )
+            result[i] = r;
+    }
+}
+
+// run whole trials concurrently, one per thread
+void PopulationManager::RunTrials(const int start){
+
+	//
+	// Each worker owns a `TrialState` (population, separations, results
+	// and a generator seeded from the trial number) and runs a whole trial
+	// on a single thread. Trials are run `threads` at a time; their output
+	// and pooled statistics are merged in trial order so the results don't
+	// depend on the number of threads.
+	//
+
+	std::vector<TrialState> state(threads);
+
+	for (int first = start; first < trials && !converged; first += threads){
+
+		int count = std::min(threads, trials - first);
+
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(count)
+		for (int w = 0; w < count; w++){
+
+			// regions within the trial get a single thread
+			omp_set_num_threads(1);
+
+			state[w].error = nullptr;
+
+			try { RunTrial(first + w, state[w]); }
+			catch (...) { state[w].error = std::current_exception(); }
+		}
+
+		omp_set_num_threads(threads);
+
+		for (int w = 0; w < count; w++){
+
+			TrialState &result = state[w];
+			int trial = first + w;
+
+			if ( result.error ) std::rethrow_exception(result.error);
+
+			// trials after convergence are dropped (whatever the threads)
+			if ( converged ) break;
+
+			if ( parser -> GetKeepPosFlag() )
+				file -> SavePositions(result.positions, trial + 1);
+
+			// counted for the checkpoint even when there is no analysis (and
+			// so no Track())
+			completed = trial + 1;
+
+			if ( !analysis ) continue;
+
+			if ( parser -> GetKeepRawFlag() )
+				file -> SaveRaw(result.seperations, trial + 1);
+
+			if ( Axis.size() == 1 ){
+
+				for ( std::size_t i = 0; i < resolution[0]; i++ ){
+
+					pooled_mean_1D[i]     += result.mean_1D[i];
+					pooled_variance_1D[i] += result.variance_1D[i];
+				}
+
+				file -> SaveOutput(result.mean_1D, result.variance_1D,
+					trial + 1);
+
+				Track(trial, result.mean_1D, result.variance_1D);
+
+			} else {
+
+				for ( std::size_t i = 0; i < resolution[0]; i++ )
+				for ( std::size_t j = 0; j < resolution[1]; j++ ){
+
+					pooled_mean_2D[i][j]     += result.mean_2D[i][j];
+					pooled_variance_2D[i][j] += result.variance_2D[i][j];
+				}
+
+				file -> SaveOutput(result.mean_2D, result.variance_2D,
+					trial + 1);
+
+				Track(trial, result.mean_2D, result.variance_2D);
+			}
+		}
+
+		if ( verbose == 2 )
+			display -> Progress(first + count, trials);
+
+		// a window may step over a multiple of `--checkpoint-every`
+		if ( completed / checkpoint_every > first / checkpoint_every ||
+			completed == trials || converged ) SaveProgress(completed);
+	}
+}
+
+// build, search and fit one trial into `state` (on the calling thread)
+void PopulationManager::RunTrial(const int trial, TrialState &state){
+
+	// a substream per trial, independent of the thread running it
+	ParallelMT source(1, first_seed + 0x9E3779B97F4A7C15ULL *
+		(unsigned long long) (trial + 1));
+	QuasiRandom quasi(sequence, 1, first_seed + 0x9E3779B97F4A7C15ULL *
+		(unsigned long long) (trial + 1));
+
+	state.positions.resize(N);
+	DrawMany(&source, proposals ? &quasi : nullptr, 0, state.positions, 0, N);
+
+	if ( !analysis ) return;
+
+	state.seperations.assign(samples, max_seperation);
+	Separations(state.positions, state.seperations, false);
+
+	if ( Axis.size() == 1 ){
+
+		const std::vector<double> &x = Axis.at( axis[0] );
+
+		std::vector<double> coords(samples, 0.0);
+		state.positions.Coordinate(axis[0], samples, coords.data());
+
+		KernelFit1D<double> kernel(coords, state.seperations, mean_bandwidth);
+		state.mean_1D = kernel.Solve(x);
+
+		kernel.SetBandwidth(stdev_bandwidth);
+		state.variance_1D = kernel.Variance(x, true);
+
+	} else if ( Axis.size() == 2 ){
+
+		const std::vector<double> &x = Axis.at( axis[0] );
+		const std::vector<double> &y = Axis.at( axis[1] );
+
+		std::vector<double> coords_1(samples, 0.0);
+		std::vector<double> coords_2(samples, 0.0);
+		state.positions.Coordinate(axis[0], samples, coords_1.data());
+		state.positions.Coordinate(axis[1], samples, coords_2.data());
+
+		KernelFit2D<double> kernel(coords_1, coords_2, state.seperations,
+			mean_bandwidth);
+		state.mean_2D = kernel.Solve(x, y);
+
+		kernel.SetBandwidth(stdev_bandwidth);
+		state.variance_2D = kernel.Variance(x, y, true);
+
+	} else throw Exception("\n Error: From PopulationManager::RunTrial, "
+		"something is wrong. Axis.size() > 2");
+}
+
 // fit a curve/surface to the data from FindNeighbors()
 void PopulationManager::ProfileFit(const int trial){
 
@@ -278,8 +975,7 @@ void PopulationManager::ProfileFit(const int trial){
 
         // build vector of coordinates (chosen at runtime)
         std::vector<double> coords(samples, 0.0);
-        for ( std::size_t i = 0; i < samples; i++ )
-            coords[i] = Coord[ axis[0] ]( positions[i] );
+        positions.Coordinate(axis[0], samples, coords.data());
 
         if (verbose) std::cout
             << "done\n Solving profile with KernelFit1D ... \n";
@@ -311,6 +1007,8 @@ void PopulationManager::ProfileFit(const int trial){
         // save the results to a file
         file -> SaveOutput(mean, variance, trial + 1);
 
+        Track(trial, mean, variance);
+
     } else if ( Axis.size() == 2 ) {
 
 		if (verbose) std::cout
@@ -320,11 +1018,8 @@ void PopulationManager::ProfileFit(const int trial){
 		// build vector of coordinates (chosen at runtime)
 		std::vector<double> coords_1(samples, 0.0);
 		std::vector<double> coords_2(samples, 0.0);
-		for ( std::size_t i = 0; i < samples; i++ ){
-
-			coords_1[i] = Coord[ axis[0] ]( positions[i] );
-			coords_2[i] = Coord[ axis[1] ]( positions[i] );
-		}
+		positions.Coordinate(axis[0], samples, coords_1.data());
+		positions.Coordinate(axis[1], samples, coords_2.data());
 
 		if (verbose) std::cout
 			<< "done\n Solving profile with KernelFit2D ... \n";
@@ -366,10 +1061,254 @@ void PopulationManager::ProfileFit(const int trial){
 		// save the results to a file
 		file -> SaveOutput(mean, variance, trial + 1);
 
+		Track(trial, mean, variance);
+
     } else throw Exception("\n Error: From PopulationManager::ProfileFit, "
         "something is wrong. Axis.size() > 2");
 }
 
+std::uint64_t PopulationManager::Signature() const {
+
+	// the populations depend on the intervals unless trials run concurrently
+	std::stringstream configuration;
+	configuration.precision(17);
+	configuration << N << ' ' << samples << ' ' << first_seed << ' '
+		<< trial_parallel << ' ' << (trial_parallel ? 1 : threads) << ' '
+		<< streaming << ' ' << mean_bandwidth << ' ' << stdev_bandwidth << ' '
+		<< parser -> GetProposals() << ' ' << qmc_restart << ' '
+		<< ( profiles -> Sampler ? profiles -> Sampler -> Name() : "none" )
+		<< ' ' << ( envelope != nullptr ) << ' ' << ( voxels ?
+		voxels -> Resolution() : 0 ) << ' ' << ( profiles -> Chain ?
+		profiles -> Chain -> Describe() : "none" ) << ' ' << batched << ' '
+		<< parser -> GetInterpolation();
+
+	for ( const auto& limits : { Xlimits, Ylimits, Zlimits } )
+		configuration << ' ' << limits[0] << ' ' << limits[1];
+
+	for ( std::size_t i = 0; i < axis.size(); i++ )
+		configuration << ' ' << axis[i] << ' ' << resolution[i];
+
+	for ( const auto& pdf : parser -> GetUsedPDFs() )
+		configuration << ' ' << pdf.first << ' ' << pdf.second;
+
+	for ( const auto& pdf : parser -> GetDefinedPDFs() )
+		configuration << ' ' << pdf.first << ' ' << pdf.second;
+
+	return Checkpoint::Signature( configuration.str() );
+}
+
+std::vector<unsigned long long> PopulationManager::GetStreams() const {
+
+	std::vector<unsigned long long> state = generator -> GetState();
+
+	if ( proposals ){
+
+		std::vector<unsigned long long> quasi = proposals -> GetState();
+		state.insert(state.end(), quasi.begin(), quasi.end());
+	}
+
+	return state;
+}
+
+void PopulationManager::SetStreams(const std::vector<unsigned long long> &state){
+
+	std::size_t length = std::min(state.size(),
+		(std::size_t) threads * (NN + 1));
+
+	generator -> SetState( std::vector<unsigned long long>(state.begin(),
+		state.begin() + length) );
+
+	if ( proposals ) proposals -> SetState( std::vector<unsigned long long>(
+		state.begin() + length, state.end()) );
+}
+
+int PopulationManager::Resume(){
+
+	if ( !parser -> GetResumeFlag() )
+		return 0;
+
+	Checkpoint::State state;
+	Checkpoint::Load(checkpoint_path, state);
+
+	if ( state.completed > trials ) throw InputError("The checkpoint `" +
+		checkpoint_path + "` has more trials than --num-trials!");
+
+	if ( state.signature != Signature() ) throw InputError("The checkpoint `" +
+		checkpoint_path + "` was written with a different configuration, "
+		"only --num-trials may change when resuming!");
+
+	std::size_t pooled = Axis.size() == 1 ? resolution[0] :
+		Axis.size() == 2 ? resolution[0] * resolution[1] : 0;
+
+	if ( state.mean.size() != pooled || ( !trial_parallel &&
+		state.rng.empty() ) ) throw InputError("The checkpoint `" +
+		checkpoint_path + "` doesn't match this configuration!");
+
+	// the pooled statistics are stored flattened (row-major)
+	if ( Axis.size() == 1 ){
+
+		pooled_mean_1D     = state.mean;
+		pooled_variance_1D = state.variance;
+
+	} else if ( Axis.size() == 2 ){
+
+		for (std::size_t i = 0; i < resolution[0]; i++)
+		for (std::size_t j = 0; j < resolution[1]; j++){
+
+			pooled_mean_2D[i][j]     = state.mean[i * resolution[1] + j];
+			pooled_variance_2D[i][j] = state.variance[i * resolution[1] + j];
+		}
+	}
+
+	completed = state.completed;
+
+	if ( auto_trials ){
+
+		if ( state.squares.size() != squares.size() ) throw InputError("The "
+			"checkpoint `" + checkpoint_path + "` was written without "
+			"--num-trials auto!");
+
+		squares = state.squares;
+		std::copy(state.mean.begin(), state.mean.end(), sums.begin());
+		std::copy(state.variance.begin(), state.variance.end(),
+			sums.begin() + state.mean.size());
+
+		converged = completed >= MIN_AUTO_TRIALS && Metric() < tolerance;
+	}
+
+	// each trial has its own substream when they run concurrently
+	if ( !trial_parallel )
+		SetStreams(state.rng);
+
+	file -> Resume(state.completed);
+
+	if ( verbose ) std::cout << "\n Resuming after trial #" << state.completed
+		<< " from `" << checkpoint_path << "`" << std::endl;
+
+	return state.completed;
+}
+
+void PopulationManager::SaveProgress(const int finished){
+
+	if ( !checkpoint || ( finished % checkpoint_every &&
+		finished != trials && !converged ) ) return;
+
+	Checkpoint::State state;
+	state.completed = finished;
+	state.signature = Signature();
+
+	if ( Axis.size() == 1 ){
+
+		state.mean     = pooled_mean_1D;
+		state.variance = pooled_variance_1D;
+
+	} else if ( Axis.size() == 2 ){
+
+		for (std::size_t i = 0; i < resolution[0]; i++){
+
+			state.mean.insert(state.mean.end(), pooled_mean_2D[i].begin(),
+				pooled_mean_2D[i].end());
+			state.variance.insert(state.variance.end(),
+				pooled_variance_2D[i].begin(), pooled_variance_2D[i].end());
+		}
+	}
+
+	// while the next population is drawn the generators have moved on
+	if ( marked ) state.rng = rng_mark;
+	else if ( !trial_parallel ) state.rng = GetStreams();
+
+	state.squares = squares;
+
+	// the output of the completed trials is on disk before the checkpoint
+	file -> Drain();
+	Checkpoint::Save(checkpoint_path, state);
+}
+
+void PopulationManager::Track(const int trial, const std::vector<double> &mean,
+	const std::vector<double> &variance){
+
+	completed = trial + 1;
+
+	if ( !auto_trials )
+		return;
+
+	std::size_t cells = mean.size();
+
+	for ( std::size_t i = 0; i < cells; i++ ){
+
+		sums[i]            += mean[i];
+		squares[i]         += mean[i] * mean[i];
+		sums[cells + i]    += variance[i];
+		squares[cells + i] += variance[i] * variance[i];
+	}
+
+	double metric = Metric();
+	converged = completed >= MIN_AUTO_TRIALS && metric < tolerance;
+
+	std::ofstream log(convergence_path.c_str(), std::ios::app);
+	log.precision(8);
+	log << completed << ' ' << metric << '\n';
+
+	if ( !log ) throw IOError("From PopulationManager::Track(), I failed "
+		"writing to `" + convergence_path + "`!");
+
+	if ( verbose && verbose != 2 ) std::cout << "\n Trial #" << completed
+		<< ", relative standard error = " << metric << " (--tolerance "
+		<< tolerance << ")" << ( converged ? ", converged" : "" ) << std::endl;
+}
+
+void PopulationManager::Track(const int trial,
+	const std::vector< std::vector<double> > &mean,
+	const std::vector< std::vector<double> > &variance){
+
+	std::vector<double> flat_mean, flat_variance;
+
+	for ( std::size_t i = 0; i < mean.size(); i++ ){
+
+		flat_mean.insert(flat_mean.end(), mean[i].begin(), mean[i].end());
+		flat_variance.insert(flat_variance.end(), variance[i].begin(),
+			variance[i].end());
+	}
+
+	Track(trial, flat_mean, flat_variance);
+}
+
+double PopulationManager::Metric() const {
+
+	//
+	// The standard error of the pooled mean (and of the pooled variance) in
+	// each cell of the grid is the spread of the trials over sqrt(n). It is
+	// taken relative to the largest value on the grid, not the value in
+	// that cell, so the empty tails of a profile don't hold up the run.
+	//
+
+	if ( completed < 2 )
+		return std::numeric_limits<double>::infinity();
+
+	double n = completed, worst = 0.0;
+	std::size_t cells = sums.size() / 2;
+
+	for ( std::size_t half = 0; half < 2; half++ ){
+
+		double scale = 0.0, error = 0.0;
+
+		for ( std::size_t i = half * cells; i < (half + 1) * cells; i++ ){
+
+			double mean     = sums[i] / n;
+			double variance = std::max(0.0, (squares[i] - n * mean * mean) /
+				(n - 1.0));
+
+			scale = std::max(scale, std::abs(mean));
+			error = std::max(error, std::sqrt(variance / n));
+		}
+
+		if ( scale > 0.0 )
+			worst = std::max(worst, error / scale);
+	}
+
+	return worst;
+}
+
 // combine statistics for all trials
 void PopulationManager::Analysis(){
 
@@ -383,10 +1322,10 @@ void PopulationManager::Analysis(){
 	if ( Axis.size() == 1 ){
 
 		for (auto &x : pooled_mean_1D)
-			x /= trials;
+			x /= completed;
 
 		for (auto &x : pooled_variance_1D)
-			x /= trials;
+			x /= completed;
 
 		if (verbose)
 			std::cout << "done";
@@ -398,8 +1337,8 @@ void PopulationManager::Analysis(){
 		for (std::size_t i = 0; i < resolution[0]; i++)
 		for (std::size_t j = 0; j < resolution[1]; j++){
 
-			pooled_mean_2D[i][j]     /= trials;
-			pooled_variance_2D[i][j] /= trials;
+			pooled_mean_2D[i][j]     /= completed;
+			pooled_variance_2D[i][j] /= completed;
 		}
 
 		if (verbose)
@@ -426,10 +1365,10 @@ std::vector<double> PopulationManager::Linespace(const double start,
     return linespace;
 }
 
-std::vector<Interval> Interval::Build(const std::vector<Vector> &input,
+std::vector<Interval> Interval::Build(const std::size_t length,
 	const std::size_t num){
 	//
-	// `Build` a vector of `Interval`s based on an `input` vector and the
+	// `Build` a vector of `Interval`s for a vector of `length` and the
 	// `num`ber of subdivisions requested.
 	//
 
@@ -437,9 +1376,9 @@ std::vector<Interval> Interval::Build(const std::vector<Vector> &input,
 	std::vector<Interval> output;
 
 	// the size of intervals
-	std::size_t interval_size = input.size() / num;
+	std::size_t interval_size = length / num;
 
-	// the first interval starts with the first element of the `input`
+	// the first interval starts with the first element
 	// the name `previous` will make sense further down
 	Interval previous(0, interval_size);
 	output.push_back(previous);
@@ -454,7 +1393,7 @@ std::vector<Interval> Interval::Build(const std::vector<Vector> &input,
 	}
 
 	// rectify final interval (for odd lengths)
-	output[num-1].end = input.size() - 1;
+	output[num-1].end = length - 1;
 
 	return output;
 }
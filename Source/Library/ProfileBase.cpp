@@ -9,11 +9,18 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <stdlib.h>
 
 #include <ProfileBase.hpp>
+#include <ProfileCache.hpp>
 #include <Exception.hpp>
 #include <Interpolate.hpp>
+#include <BinaryFile.hpp>
+#include <Fits.hpp>
 #include <Parser.hpp>
 
 namespace Gaia {
@@ -25,6 +32,11 @@ ProfileBase::ProfileBase(const std::string &name,
 	// set pointers to nullptr immediately
 	Linear_Data   = nullptr;
 	BiLinear_Data = nullptr;
+	BiCubic_Data  = nullptr;
+	TriLinear_Data = nullptr;
+	_alias        = nullptr;
+	_coord1       = nullptr;
+	_coord2       = nullptr;
 
 	// set name
 	_name = name;
@@ -52,6 +64,10 @@ ProfileBase::ProfileBase(const std::string &name,
 
 	// assume analytical
 	_analytical = true;
+	_1D = _2D = _3D = false;
+
+	// with no assumptions
+	symmetry = NONE;
 }
 
 ProfileBase::~ProfileBase(){
@@ -65,6 +81,21 @@ ProfileBase::~ProfileBase(){
 		delete BiLinear_Data;
 		BiLinear_Data = nullptr;
 	}
+
+	if (BiCubic_Data){
+		delete BiCubic_Data;
+		BiCubic_Data = nullptr;
+	}
+
+	if (TriLinear_Data){
+		delete TriLinear_Data;
+		TriLinear_Data = nullptr;
+	}
+
+	if (_alias){
+		delete _alias;
+		_alias = nullptr;
+	}
 }
 
 void ProfileBase::Initialize(std::string &filename){
@@ -86,14 +117,31 @@ void ProfileBase::Initialize(std::string &filename){
 		<< filename << "` ...";
 
 	ReplaceAll("~", std::string(getenv("HOME")), filename);
-	std::ifstream input( filename.c_str() );
 
-	if ( input ) {
+	// a cube is already binary (no text to parse or cache)
+	if ( ReadCube(filename) ){
+
+		if (verbose) std::cout << " (3D) " << _x.size() << " x " << _y.size()
+			<< " x " << _z.size() << "\n";
+
+		return;
+	}
+
+	// binary image of the table from a previous run
+	ProfileCache cache(filename, parser -> GetCachePath(), _axis1, _axis2);
+	bool cached = parser -> GetCacheFlag() && cache.Load(_data);
 
-		for ( std::string line; std::getline(input, line); )
-			_data.push_back( ReadElements(line) );
+	if ( !cached ) {
 
-	} else throw IOError("`"+filename+"` failed to open properly!\n");
+		std::ifstream input( filename.c_str() );
+
+		if ( input ) {
+
+			for ( std::string line; std::getline(input, line); )
+				_data.push_back( ReadElements(line) );
+
+		} else throw IOError("`"+filename+"` failed to open properly!\n");
+	}
 
 	// ensure appropriate input (dimensionally)
 	for ( std::size_t i = 1; i < _data.size(); i++ ){
@@ -174,6 +222,7 @@ void ProfileBase::Initialize(std::string &filename){
 
 		// construct linear data member
 		Linear_Data = new Interpolate::Linear<double>(_x, _y);
+		_coord1     = Coord[_axis1];
 
 	} else {
 
@@ -225,25 +274,318 @@ void ProfileBase::Initialize(std::string &filename){
 	        _y = Linespace(Limits[_axis2][0], Limits[_axis2][1], _data.size());
 
 	        // construct the 2D interpolation object
-	        BiLinear_Data = new Interpolate::BiLinear<double>(_x, _y, _data);
+	        if ( parser -> GetInterpolation() == "cubic" )
+	            BiCubic_Data = new Interpolate::BiCubic<double>(_x, _y, _data);
+	        else
+	            BiLinear_Data = new Interpolate::BiLinear<double>(_x, _y, _data);
+	        _coord1       = Coord[_axis1];
+	        _coord2       = Coord[_axis2];
 	}
 
+	// keep the validated table for the next run
+	if ( !cached && parser -> GetCacheFlag() && !cache.Save(_data) &&
+		verbose > 2 ) std::cout << " (could not write `" << cache.Path()
+		<< "`)";
+
 	// update user
 	if (verbose){
-		std::string dim = _1D ? " (1D) " : " (2D) ";
-		std::cout << dim << _data.size() << " x " << _data[0].size() << "\n";
+		std::string dim = _1D ? " (1D) " : BiCubic_Data ? " (2D, bicubic) " :
+			" (2D) ";
+		std::cout << dim << _data.size() << " x " << _data[0].size();
+		std::cout << (cached ? " (cached)\n" : "\n");
 	}
 }
 
 // generalized function for evaluating the profile
-double ProfileBase::Evaluate(const Vector &vec){
+double ProfileBase::Evaluate(const Point &point){
+
+		if (_analytical) return Function(point);
+
+		if (_1D) return Linear_Data -> Interpolate( _coord1(point) );
+
+		if (_3D) return TriLinear_Data -> Interpolate( point.X(), point.Y(),
+						point.Z() );
+
+		if (BiCubic_Data) return BiCubic_Data -> Interpolate( _coord1(point),
+						_coord2(point) );
+
+		else return BiLinear_Data -> Interpolate( _coord1(point),
+						_coord2(point) );
+}
+
+void ProfileBase::Batch(const double *x, const double *y, const double *z,
+	const std::size_t n, double *out){
+
+	if ( _analytical ){
+
+		for ( std::size_t i = 0; i < n; i++ )
+			out[i] = Evaluate( Point(x[i], y[i], z[i]) );
+
+		return;
+	}
+
+	if ( _3D ){
+
+		TriLinear_Data -> Interpolate(x, y, z, n, out);
+		return;
+	}
+
+	// positions come in any order, tables that aren't evenly spaced sort
+	// them through `order` (scratch space of each thread, as the axes)
+	static thread_local std::vector<std::size_t> order;
+	if ( order.size() < n ) order.resize(n);
+
+	const double *a = Coordinates(_axis1, _coord1, x, y, z, n, 0);
+
+	if ( _1D ){
+
+		Linear_Data -> Interpolate(a, n, out, order.data());
+		return;
+	}
+
+	const double *b = Coordinates(_axis2, _coord2, x, y, z, n, 1);
+
+	if ( BiCubic_Data ) BiCubic_Data -> Interpolate(a, b, n, out);
+	else BiLinear_Data -> Interpolate(a, b, n, out, order.data());
+}
+
+const double* ProfileBase::Coordinates(const std::string &axis,
+	double (*coord)(const Point&), const double *x, const double *y,
+	const double *z, const std::size_t n, const int slot){
+
+	if ( axis == "X" ) return x;
+	if ( axis == "Y" ) return y;
+	if ( axis == "Z" ) return z;
+
+	static thread_local std::vector<double> scratch[2];
+	if ( scratch[slot].size() < n ) scratch[slot].resize(n);
+
+	for ( std::size_t i = 0; i < n; i++ )
+		scratch[slot][i] = coord( Point(x[i], y[i], z[i]) );
+
+	return scratch[slot].data();
+}
+
+bool ProfileBase::StartSampler(){
+
+	if ( _analytical ) return PrepareSampler();
+
+	// the cells are drawn from by their bilinear surface
+	if ( !_2D || BiCubic_Data || !( (_axis1 == "X" && _axis2 == "Y") ||
+		(_axis1 == "Y" && _axis2 == "X") ) ) return false;
+
+	//
+	// Positions drawn follow the bilinear surface, while rejection keeps
+	// them with probability min(f, 1); the two only agree for a table
+	// within [0, 1], any other is left to rejection. The surface over a cell
+	// has the mean of its corners times the area of the cell for its mass.
+	//
+
+	for ( const auto& row : _data )
+	for ( const auto& value : row )
+		if ( !(value >= 0.0 && value <= 1.0) ) return false;
+
+	std::size_t columns = _x.size() - 1, rows = _y.size() - 1;
+	std::vector<double> mass(columns * rows);
+	double total = 0.0;
+
+	for ( std::size_t j = 0; j < rows; j++ )
+	for ( std::size_t i = 0; i < columns; i++ ){
+
+		double corners = _data[j][i] + _data[j][i + 1] + _data[j + 1][i] +
+			_data[j + 1][i + 1];
+
+		mass[j * columns + i] = 0.25 * corners * (_x[i + 1] - _x[i]) *
+			(_y[j + 1] - _y[j]);
+		total += mass[j * columns + i];
+	}
+
+	if ( !(total > 0.0) ) throw ProfileError("The table for `" + _name +
+		"` is zero everywhere in the `box`!");
+
+	_alias = new AliasTable(mass);
+	_swap  = _axis1 == "Y";
+
+	return true;
+}
+
+Vector ProfileBase::Propose(ParallelMT *source, const int thread){
+
+	if ( _analytical ) return Sample(source, thread);
+
+	std::size_t cell = _alias -> Pick(source -> RandomReal(thread),
+		source -> RandomReal(thread));
+
+	std::size_t columns = _x.size() - 1;
+	std::size_t j = cell / columns, i = cell % columns;
+
+	double v00 = _data[j][i], v10 = _data[j][i + 1];
+	double v01 = _data[j + 1][i], v11 = _data[j + 1][i + 1];
+
+	// the marginal along the first axis is linear, and then so is the
+	// second one given the first
+	double t = LinearDensity(source -> RandomReal(thread), v00 + v01, v10 + v11);
+	double s = LinearDensity(source -> RandomReal(thread),
+		(1.0 - t) * v00 + t * v10, (1.0 - t) * v01 + t * v11);
+
+	double a = _x[i] + t * (_x[i + 1] - _x[i]);
+	double b = _y[j] + s * (_y[j + 1] - _y[j]);
+
+	const std::vector<double> &z = Limits.at("Z");
+	double c = z[0] + (z[1] - z[0]) * source -> RandomReal(thread);
+
+	return _swap ? Vector(b, a, c) : Vector(a, b, c);
+}
+
+ProfileBase::Symmetry ProfileBase::GetSymmetry() const {
+
+	if ( _analytical ) return symmetry;
+
+	if ( _1D ) return _axis1 == "R" ? AXISYMMETRIC : _axis1 == "Rho" ?
+		SPHERICAL : _axis1 == "Z" ? PLANAR : NONE;
+
+	bool R = _axis1 == "R" || _axis2 == "R";
+	bool Z = _axis1 == "Z" || _axis2 == "Z";
+
+	return R && Z ? AXISYMMETRIC : NONE;
+}
+
+double ProfileBase::MaxR() const {
+
+	const std::vector<double> &x = Limits.at("X"), &y = Limits.at("Y");
+
+	double max_X = std::max(std::abs(x[0]), std::abs(x[1]));
+	double max_Y = std::max(std::abs(y[0]), std::abs(y[1]));
+
+	return std::sqrt(max_X * max_X + max_Y * max_Y);
+}
+
+double ProfileBase::Laplace(const double u, const double scale,
+	const double lower, const double upper){
 
-		if (_analytical) return Function(vec);
+	// cumulative of exp(-|z| / scale) from -infinity, and its inverse
+	auto G = [scale](double z){ return z < 0.0 ? scale * std::exp(z / scale) :
+		2.0 * scale - scale * std::exp(-z / scale); };
 
-		if (_1D) return Linear_Data -> Interpolate( Coord[_axis1](vec) );
+	double target = G(lower) + u * (G(upper) - G(lower));
 
-		else return BiLinear_Data -> Interpolate( Coord[_axis1](vec),
-						Coord[_axis2](vec) );
+	double z = target < scale ? scale * std::log(target / scale) :
+		-scale * std::log((2.0 * scale - target) / scale);
+
+	return std::min(upper, std::max(lower, z));
+}
+
+double ProfileBase::PowerLaw(const double u, const double index,
+	const double lower, const double upper){
+
+	if ( std::abs(index + 1.0) < 1e-12 )
+		return lower * std::pow(upper / lower, u);
+
+	double a = std::pow(lower, index + 1.0), b = std::pow(upper, index + 1.0);
+
+	return std::pow(a + u * (b - a), 1.0 / (index + 1.0));
+}
+
+namespace {
+
+// inverse of the standard normal cumulative distribution (Acklam's rational
+// approximation and one step of Halley's method)
+double InverseNormal(const double p){
+
+	if ( p <= 0.0 ) return -HUGE_VAL;
+	if ( p >= 1.0 ) return  HUGE_VAL;
+
+	static const double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02,
+		-2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01,
+		2.506628277459239e+00 };
+	static const double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02,
+		-1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+	static const double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01,
+		-2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00,
+		2.938163982698783e+00 };
+	static const double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01,
+		2.445134137142996e+00, 3.754408661907416e+00 };
+
+	double x;
+
+	if ( p < 0.02425 ){
+
+		double q = std::sqrt(-2.0 * std::log(p));
+		x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+			((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.0);
+
+	} else if ( p > 1.0 - 0.02425 ){
+
+		double q = std::sqrt(-2.0 * std::log(1.0 - p));
+		x = -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+			((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1.0);
+
+	} else {
+
+		double q = p - 0.5, r = q * q;
+		x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q /
+			(((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1.0);
+	}
+
+	double e = 0.5 * std::erfc(-x / std::sqrt(2.0)) - p;
+	double g = e * std::sqrt(2.0 * 3.141592653589793) * std::exp(0.5 * x * x);
+
+	return x - g / (1.0 + 0.5 * x * g);
+}
+
+} // anonymous namespace
+
+double ProfileBase::TruncatedNormal(const double u, const double mean,
+	const double sigma, const double lower, const double upper){
+
+	double alpha = (lower - mean) / sigma, beta = (upper - mean) / sigma;
+	double x;
+
+	// work in the tail the interval is in, where the precision is
+	if ( alpha > 0.0 ){
+
+		double qa = 0.5 * std::erfc(alpha / std::sqrt(2.0));
+		double qb = 0.5 * std::erfc(beta  / std::sqrt(2.0));
+
+		if ( !(qa > qb) ) throw ProfileError("From "
+			"ProfileBase::TruncatedNormal(), there is no mass in the `box`!");
+
+		x = -InverseNormal(qa - u * (qa - qb));
+
+	} else {
+
+		double pa = 0.5 * std::erfc(-alpha / std::sqrt(2.0));
+		double pb = 0.5 * std::erfc(-beta  / std::sqrt(2.0));
+
+		if ( !(pb > pa) ) throw ProfileError("From "
+			"ProfileBase::TruncatedNormal(), there is no mass in the `box`!");
+
+		x = InverseNormal(pa + u * (pb - pa));
+	}
+
+	return std::min(upper, std::max(lower, mean + sigma * x));
+}
+
+double ProfileBase::LinearDensity(const double u, const double a,
+	const double b){
+
+	// root of a t + (b - a) t^2 / 2 = u (a + b) / 2 without cancellation
+	double root = std::sqrt(a * a + u * (b * b - a * a));
+
+	return root + a > 0.0 ? std::min(1.0, u * (a + b) / (a + root)) : u;
+}
+
+double ProfileBase::ExponentialDisk(ParallelMT *source, const int thread,
+	const double scale, const double limit){
+
+	// a sum of two exponentials, redrawn in the far tail beyond `limit`
+	while ( true ){
+
+		double r = -scale * std::log( (1.0 - source -> RandomReal(thread)) *
+			(1.0 - source -> RandomReal(thread)) );
+
+		if ( r <= limit ) return r;
+	}
 }
 
 // convert new line of text from file into vector<double>
@@ -279,6 +621,83 @@ std::vector<double> ProfileBase::Linespace(const double start, const double end,
 	return linespace;
 }
 
+bool ProfileBase::ReadCube(const std::string &filename){
+
+	char magic[8] = { 0 };
+	FILE *input = std::fopen(filename.c_str(), "rb");
+
+	if ( !input ) throw IOError("`"+filename+"` failed to open properly!\n");
+
+	std::size_t got = std::fread(magic, 1, sizeof(magic), input);
+	std::fclose(input);
+
+	bool binary = got == 8 && !std::strncmp(magic, "GAIABIN", 8);
+	bool fits   = got == 8 && !std::strncmp(magic, "SIMPLE  ", 8);
+
+	if ( !binary && !fits ) return false;
+
+	if ( !_axis1.empty() || !_axis2.empty() ){
+
+		std::stringstream warning;
+		warning << "From file `" << filename << "`, I have detected ";
+		warning << "a 3D data set but you specified an axis for `";
+		warning << _name << "` in `Profiles.hpp`! A cube always spans ";
+		warning << "X, Y and Z of the `box`.\n";
+
+		throw ProfileError( warning.str() );
+	}
+
+	std::size_t shape[3] = { 0, 0, 0 };
+	std::vector<double> cube;
+
+	if ( binary ){
+
+		std::vector< std::vector<double> > planes;
+		BinaryFile::Header header = BinaryFile::Read(filename, planes);
+
+		for ( int a = 0; a < 3; a++ )
+			shape[a] = header.shape[a];
+
+		if ( std::strncmp(header.kind, "cube", sizeof(header.kind)) ||
+			header.columns != shape[2] || header.rows != shape[0] * shape[1] ){
+
+			std::stringstream warning;
+			warning << "From file `" << filename << "`, a binary profile ";
+			warning << "must be of kind `cube` with one column of ";
+			warning << "`shape[0] * shape[1]` values per Z plane!\n";
+
+			throw ProfileError( warning.str() );
+		}
+
+		cube.reserve(header.rows * header.columns);
+		for ( const auto& plane : planes )
+			cube.insert(cube.end(), plane.begin(), plane.end());
+
+	} else Fits::ReadCube(filename, shape, cube);
+
+	if ( shape[0] < 2 || shape[1] < 2 || shape[2] < 2 ){
+
+		std::stringstream warning;
+		warning << "From file `" << filename << "`, a cube must have at ";
+		warning << "least two values along each axis!\n";
+
+		throw ProfileError( warning.str() );
+	}
+
+	_1D = false;
+	_2D = false;
+	_3D = true;
+
+	// the cells span the `box`, as the pixels of a 2D table do
+	_x = Linespace(Limits["X"][0], Limits["X"][1], shape[0]);
+	_y = Linespace(Limits["Y"][0], Limits["Y"][1], shape[1]);
+	_z = Linespace(Limits["Z"][0], Limits["Z"][1], shape[2]);
+
+	TriLinear_Data = new Interpolate::TriLinear<double>(_x, _y, _z, cube);
+
+	return true;
+}
+
 // replace all instances of `search_str` in `input_str` with `replace_str`
 void ProfileBase::ReplaceAll(const std::string &search_str,
     const std::string &replace_str, std::string& input_str ){
@@ -0,0 +1,211 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/ProfileCache.cc
+//
+// Source file for the `ProfileCache` class. See Include/ProfileCache.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ProfileCache.hpp>
+
+#define CACHE_MAGIC   "GAIAPRF"
+#define CACHE_VERSION 1
+#define CACHE_ORDER   0x01020304
+
+namespace Gaia {
+
+static_assert(sizeof(ProfileCache::Header) == 64,
+	"ProfileCache::Header must be exactly 64 bytes!");
+
+ProfileCache::ProfileCache(const std::string &source,
+	const std::string &directory, const std::string &axis1,
+	const std::string &axis2){
+
+	_source = source;
+	_axis1  = axis1;
+	_axis2  = axis2;
+	_keyed  = false;
+
+	if ( directory.empty() ) {
+
+		// the image lives next to the source
+		_path = source + ".cache";
+
+	} else {
+
+		// name the image by the source's base name and the hash of its full
+		// path so files of the same name in different places don't collide
+		std::size_t pos = source.find_last_of("/");
+		std::string base = pos == std::string::npos ? source :
+			source.substr(pos + 1);
+
+		std::stringstream buffer;
+		buffer << directory << "/" << base << "." << std::hex << Hash(
+			(const unsigned char*) source.c_str(), source.length()) << ".cache";
+		_path = buffer.str();
+	}
+}
+
+bool ProfileCache::Key(){
+
+	//
+	// Stat and hash the source file. The hash is computed over the raw bytes
+	// which is far cheaper than parsing the text.
+	//
+
+	if (_keyed) return true;
+
+	int fd = open(_source.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if ( fstat(fd, &info) ) { close(fd); return false; }
+
+	_size  = info.st_size;
+#ifdef __APPLE__
+	_mtime = std::int64_t(info.st_mtimespec.tv_sec) * 1000000000LL +
+		info.st_mtimespec.tv_nsec;
+#else
+	_mtime = std::int64_t(info.st_mtim.tv_sec) * 1000000000LL +
+		info.st_mtim.tv_nsec;
+#endif
+
+	if ( _size ) {
+
+		void *contents = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if ( contents == MAP_FAILED ) { close(fd); return false; }
+
+		_hash = Hash((const unsigned char*) contents, _size);
+		munmap(contents, _size);
+
+	} else _hash = Hash(nullptr, 0);
+
+	close(fd);
+	return _keyed = true;
+}
+
+bool ProfileCache::Load(std::vector< std::vector<double> > &data){
+
+	//
+	// Map the image and copy the table into `data` if the key in its header
+	// matches the source. Any mismatch or malformed image is a `miss`.
+	//
+
+	if ( !Key() ) return false;
+
+	int fd = open(_path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if ( fstat(fd, &info) || std::size_t(info.st_size) < sizeof(Header) ){
+		close(fd);
+		return false;
+	}
+
+	std::size_t length = info.st_size;
+	void *image = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( image == MAP_FAILED ) return false;
+
+	const Header *header = (const Header*) image;
+	const double *table  = (const double*) ((const char*) image +
+		sizeof(Header));
+
+	bool match =
+		!std::strncmp(header -> magic, CACHE_MAGIC, sizeof(header -> magic)) &&
+		header -> version    == CACHE_VERSION &&
+		header -> byte_order == CACHE_ORDER   &&
+		header -> mtime      == _mtime &&
+		header -> size       == _size  &&
+		header -> hash       == _hash  &&
+		!std::strncmp(header -> axis1, _axis1.c_str(),
+			sizeof(header -> axis1) - 1) &&
+		!std::strncmp(header -> axis2, _axis2.c_str(),
+			sizeof(header -> axis2) - 1) &&
+		length == sizeof(Header) + header -> rows * header -> cols *
+			sizeof(double);
+
+	if ( match ) {
+
+		data.assign(header -> rows, std::vector<double>());
+
+		for ( std::size_t i = 0; i < header -> rows; i++ )
+			data[i].assign(table + i * header -> cols,
+				table + (i + 1) * header -> cols);
+	}
+
+	munmap(image, length);
+	return match;
+}
+
+bool ProfileCache::Save(const std::vector< std::vector<double> > &data){
+
+	//
+	// Write the image to a temporary file and rename it into place so
+	// concurrent jobs never see a partial image.
+	//
+
+	if ( data.empty() || !Key() ) return false;
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	// the fields stay terminated (`Theta` is kept as `The`)
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	std::strncpy(header.axis1, _axis1.c_str(), sizeof(header.axis1) - 1);
+	std::strncpy(header.axis2, _axis2.c_str(), sizeof(header.axis2) - 1);
+	header.version    = CACHE_VERSION;
+	header.byte_order = CACHE_ORDER;
+	header.rows       = data.size();
+	header.cols       = data[0].size();
+	header.mtime      = _mtime;
+	header.size       = _size;
+	header.hash       = _hash;
+
+	std::stringstream buffer;
+	buffer << _path << ".tmp" << getpid();
+	std::string temp = buffer.str();
+
+	FILE *output = std::fopen(temp.c_str(), "wb");
+	if ( !output ) return false;
+
+	bool good = std::fwrite(&header, sizeof(Header), 1, output) == 1;
+
+	for ( const auto& row : data )
+		if ( good ) good = std::fwrite(row.data(), sizeof(double),
+			row.size(), output) == row.size();
+
+	good = !std::fclose(output) && good;
+
+	if ( !good || std::rename(temp.c_str(), _path.c_str()) ) {
+
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+std::uint64_t ProfileCache::Hash(const unsigned char *bytes, std::size_t n){
+
+	std::uint64_t hash = 14695981039346656037ULL;
+
+	for ( std::size_t i = 0; i < n; i++ ){
+
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+} // namespace Gaia
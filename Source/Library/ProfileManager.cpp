@@ -4,17 +4,38 @@
 //
 // #TODO:30 source
 
+#include <iostream>
 #include <sstream>
 #include <vector>
 #include <string>
 #include <map>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 
 #include <ProfileManager.hpp>
 #include <Profiles.hpp>
+#include <DefinedProfile.hpp>
+#include <PluginProfile.hpp>
+#include <Random.hpp>
+
+// uniform positions to compare the profiles with samplers
+#define SAMPLER_PROBES 4096
+#define SAMPLER_SEED   19650218ULL
+
+// timing passes over the warm-up candidates (the fastest counts), and the
+// most profiles whose every order is tried
+#define REORDER_REPEATS    3
+#define REORDER_EXHAUSTIVE 6
 
 namespace Gaia {
 
-ProfileManager::ProfileManager(){}
+ProfileManager::ProfileManager(){
+
+    Sampler = nullptr;
+    Chain   = nullptr;
+}
 
 ProfileManager::~ProfileManager(){
 
@@ -29,6 +50,11 @@ ProfileManager::~ProfileManager(){
     }
 
     UsedPDFs.clear();
+
+    if ( Chain ){
+        delete Chain;
+        Chain = nullptr;
+    }
 }
 
 void ProfileManager::Initialize(){
@@ -43,7 +69,9 @@ void ProfileManager::Initialize(){
     KnownPDFs.push_back( new Spiral() );
     KnownPDFs.push_back( new Metallicity() );
     KnownPDFs.push_back( new Habitability() );
+    KnownPDFs.push_back( new Halo() );
     KnownPDFs.push_back( new Surface() );
+    KnownPDFs.push_back( new Density() );
 
     // map profiles to their names
     std::map<std::string, ProfileBase*> available;
@@ -56,6 +84,58 @@ void ProfileManager::Initialize(){
     // retrieve the map of used profiles from the parser
     std::map<std::string, std::string> given = parser -> GetUsedPDFs();
 
+    // profiles defined in the rc file are compiled when used
+    std::map<std::string, std::string> defined = parser -> GetDefinedPDFs();
+
+    for ( auto& definition : defined ){
+
+        if ( available.find( definition.first ) != available.end() ){
+
+            std::stringstream warning;
+            warning << "From file `" << parser -> GetRCFile() << "`, ";
+            warning << "the defined profile `" << definition.first;
+            warning << "` has the name of one in `Profiles.hpp`!";
+            throw ProfileError( warning.str() );
+        }
+
+        if ( given.find( definition.first ) == given.end() ) continue;
+
+        if ( !given[ definition.first ].empty() ){
+
+            std::stringstream warning;
+            warning << "From file `" << parser -> GetRCFile() << "`, ";
+            warning << "the defined profile `" << definition.first;
+            warning << "` was included with a file!";
+            throw ProfileError( warning.str() );
+        }
+
+        DefinedProfile *pdf = new DefinedProfile(definition.first,
+            definition.second);
+        available[ definition.first ] = pdf;
+
+        if ( parser -> GetVerbosity() ) std::cout << "\n Compiled `"
+            << definition.first << "` into " << pdf -> GetExpression().
+            Instructions() << " instruction(s)" << std::endl;
+    }
+
+    // profiles from shared libraries are loaded when used (the file given
+    // with one is handed to the plugin instead)
+    for ( auto& profile : given ){
+
+        if ( profile.first.compare(0, 7, "plugin:") ) continue;
+
+        if ( available.find( profile.first ) != available.end() ) continue;
+
+        PluginProfile *pdf = new PluginProfile(profile.first,
+            profile.first.substr(7), profile.second);
+        available[ profile.first ] = pdf;
+        profile.second = "";
+
+        if ( parser -> GetVerbosity() ) std::cout << "\n Loaded `"
+            << pdf -> Description() << "` from `" << profile.first.substr(7)
+            << "`" << std::endl;
+    }
+
     for ( auto& profile : given ){
 
         if ( available.find( profile.first ) == available.end() ){
@@ -84,6 +164,218 @@ void ProfileManager::Initialize(){
         }
 
     }
+
+#ifdef CHAINS
+
+    //
+    // Combinations of the profiles above compiled into a single test (see
+    // ProfileChain.hpp), the first whose classes are exactly the profiles in
+    // use replaces the loop over them. A chain tests in the order listed.
+    //
+
+    ChainBase* (*chains[])(const std::vector<ProfileBase*>&) = {
+
+        ProfileChain<MilkyWay>::Compose,
+        ProfileChain<Spiral>::Compose,
+        ProfileChain<MilkyWay, Spiral>::Compose,
+        ProfileChain<MilkyWay, Metallicity>::Compose,
+        ProfileChain<Spiral, Metallicity>::Compose,
+        ProfileChain<MilkyWay, Spiral, Metallicity>::Compose,
+        ProfileChain<MilkyWay, Habitability>::Compose
+    };
+
+    for ( const auto& Compose : chains )
+        if ( !Chain ) Chain = Compose(UsedPDFs);
+
+#endif
+
+    //
+    // Positions proposed by the Mersenne Twister can come from a sampler.
+    // Of the profiles that have one, the most selective proposes (the one
+    // with the smallest mean over the `box`, estimated from a fixed set of
+    // uniform positions).
+    //
+
+    if ( !parser -> GetSamplerFlag() || parser -> GetProposals() != "mt" )
+        return;
+
+    std::vector<double> X = parser -> GetXlimits();
+    std::vector<double> Y = parser -> GetYlimits();
+    std::vector<double> Z = parser -> GetZlimits();
+    double selective = 0.0;
+
+    for ( auto& pdf : UsedPDFs ){
+
+        if ( !pdf -> StartSampler() ) continue;
+
+        MT19937 uniform(SAMPLER_SEED);
+        double mean = 0.0;
+
+        for ( int i = 0; i < SAMPLER_PROBES; i++ ){
+
+            Vector position(X[0] + (X[1] - X[0]) * uniform.RandomReal(),
+                Y[0] + (Y[1] - Y[0]) * uniform.RandomReal(),
+                Z[0] + (Z[1] - Z[0]) * uniform.RandomReal());
+
+            mean += pdf -> Evaluate(position) / SAMPLER_PROBES;
+        }
+
+        if ( !Sampler || mean < selective ){
+
+            Sampler   = pdf;
+            selective = mean;
+        }
+    }
+}
+
+bool ProfileManager::Batched() const {
+
+    for ( const auto& pdf : UsedPDFs )
+        if ( pdf != Sampler && pdf -> Batched() )
+            return true;
+
+    return false;
+}
+
+bool ProfileManager::Axisymmetric() const {
+
+    for ( const auto& pdf : UsedPDFs )
+        if ( pdf -> GetSymmetry() == ProfileBase::NONE )
+            return false;
+
+    return !UsedPDFs.empty();
+}
+
+void ProfileManager::Reorder(double &given, double &chosen){
+
+    //
+    // A candidate is tested against the profiles in turn until one rejects
+    // it, so the expected cost of an order is the sum of the cost of each
+    // profile times the chance the candidate got that far. Both are
+    // measured on the same warm-up candidates for every profile, which
+    // keeps any correlation between the profiles.
+    //
+
+    std::vector<ProfileBase*> tested;
+    for ( const auto& pdf : UsedPDFs )
+        if ( pdf != Sampler ) tested.push_back(pdf);
+
+    std::size_t n = tested.size();
+    given = chosen = 0.0;
+    if ( !n ) return;
+
+    Parser *parser = Parser::GetInstance();
+    std::vector<double> X = parser -> GetXlimits();
+    std::vector<double> Y = parser -> GetYlimits();
+    std::vector<double> Z = parser -> GetZlimits();
+
+    // warm-up candidates, as `Build` would propose them
+    ParallelMT source(1, SAMPLER_SEED);
+    std::vector<Vector> candidates;
+
+    for ( std::size_t i = 0; candidates.size() < SAMPLER_PROBES &&
+        i < 64 * SAMPLER_PROBES; i++ ){
+
+        Vector position = Sampler ? Sampler -> Propose(&source, 0) : Vector(
+            source.RandomReal(0, X), source.RandomReal(0, Y),
+            source.RandomReal(0, Z));
+
+        if ( position.X() < X[0] || position.X() > X[1] ||
+            position.Y() < Y[0] || position.Y() > Y[1] ||
+            position.Z() < Z[0] || position.Z() > Z[1] ) continue;
+
+        candidates.push_back(position);
+    }
+
+    if ( candidates.empty() ) return;
+    std::size_t m = candidates.size();
+
+    // seconds per evaluation and chance of passing at each candidate
+    std::vector<double> cost(n);
+    std::vector< std::vector<double> > pass(n, std::vector<double>(m));
+
+    for ( std::size_t k = 0; k < n; k++ ){
+
+        for ( int r = 0; r < REORDER_REPEATS; r++ ){
+
+            auto start = std::chrono::steady_clock::now();
+
+            for ( std::size_t i = 0; i < m; i++ )
+                pass[k][i] = tested[k] -> Evaluate(candidates[i]);
+
+            double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count() / m;
+
+            if ( !r || elapsed < cost[k] ) cost[k] = elapsed;
+        }
+
+        for ( auto& p : pass[k] )
+            p = std::min(1.0, std::max(0.0, p));
+    }
+
+    auto Expected = [&](const std::vector<std::size_t> &order){
+
+        double total = 0.0;
+
+        for ( std::size_t i = 0; i < m; i++ ){
+
+            double reached = 1.0;
+
+            for ( const auto& k : order ){
+
+                total   += reached * cost[k];
+                reached *= pass[k][i];
+            }
+        }
+
+        return total / m;
+    };
+
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    given = chosen = Expected(order);
+
+    if ( n <= REORDER_EXHAUSTIVE ){
+
+        // every order (they are few)
+        std::vector<std::size_t> best = order;
+
+        while ( std::next_permutation(order.begin(), order.end()) ){
+
+            double expected = Expected(order);
+            if ( expected < chosen ){
+
+                chosen = expected;
+                best   = order;
+            }
+        }
+
+        order = best;
+
+    } else {
+
+        // for independent profiles the best order is by cost / P(reject)
+        std::vector<double> rank(n);
+        for ( std::size_t k = 0; k < n; k++ ){
+
+            double mean = std::accumulate(pass[k].begin(), pass[k].end(),
+                0.0) / m;
+            rank[k] = mean < 1.0 ? cost[k] / (1.0 - mean) :
+                std::numeric_limits<double>::max();
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a,
+            std::size_t b){ return rank[a] < rank[b]; });
+
+        chosen = std::min(given, Expected(order));
+        if ( chosen == given ) std::iota(order.begin(), order.end(), 0);
+    }
+
+    // the sampler (never tested) goes first
+    UsedPDFs.clear();
+    if ( Sampler ) UsedPDFs.push_back(Sampler);
+    for ( const auto& k : order )
+        UsedPDFs.push_back(tested[k]);
 }
 
 } // namespace Gaia
@@ -2,8 +2,11 @@
 // GNU General Public License v3.0
 // Library/Random.cc
 //
-// This source file contains the definitions for the MT19937 object and the
-// wrapper class ParallelMT.
+// This source file contains the definitions for the MT19937 object, the
+// wrapper class ParallelMT and QuasiRandom.
+
+#include <cmath>
+#include <algorithm>
 
 #include <Random.hpp>
 #include <Exception.hpp>
@@ -108,6 +111,20 @@ double MT19937::RandomReal() {
     return (RandomInteger() >> 11) * (1.0/9007199254740991.0);
 }
 
+void MT19937::GetState(std::vector<unsigned long long> &state) const {
+
+	state.insert(state.end(), mt, mt + NN);
+	state.push_back(mti);
+}
+
+void MT19937::SetState(const unsigned long long *state){
+
+	for (int i = 0; i < NN; i++)
+		mt[i] = state[i];
+
+	mti = state[NN];
+}
+
 // construct MT19937 family from first seed
 ParallelMT::ParallelMT(const int threads, const unsigned long long first_seed){
 
@@ -190,4 +207,208 @@ double ParallelMT::RandomReal(const int thread,
     "a generator by thread number that was out of bounds!");
 }
 
+std::vector<unsigned long long> ParallelMT::GetState() const {
+
+	std::vector<unsigned long long> state;
+	for (int i = 0; i < _threads; i++)
+		generator[i] -> GetState(state);
+
+	return state;
+}
+
+void ParallelMT::SetState(const std::vector<unsigned long long> &state){
+
+	if ( state.size() != (std::size_t) _threads * (NN + 1) )
+		throw IndexError("From ParallelMT::SetState(), the state doesn't "
+		"match the number of generators!");
+
+	for (int i = 0; i < _threads; i++)
+		generator[i] -> SetState( &state[i * (NN + 1)] );
+}
+
+AliasTable::AliasTable(const std::vector<double> &weights){
+
+	std::size_t n = weights.size();
+	double total  = 0.0;
+
+	for (const auto& w : weights){
+
+		if ( !(w >= 0.0) ) throw IndexError("From AliasTable::AliasTable(), "
+			"the weights can't be negative!");
+
+		total += w;
+	}
+
+	if ( !n || !(total > 0.0) ) throw IndexError("From "
+		"AliasTable::AliasTable(), there must be a positive weight!");
+
+	_probability.resize(n);
+	_alias.resize(n);
+
+	// scaled so the average is one, then split into small and large
+	std::vector<double> scaled(n);
+	std::vector<std::size_t> small, large;
+
+	for (std::size_t i = 0; i < n; i++){
+
+		scaled[i] = weights[i] * n / total;
+		( scaled[i] < 1.0 ? small : large ).push_back(i);
+	}
+
+	// each small entry is topped up by a large one
+	while ( !small.empty() && !large.empty() ){
+
+		std::size_t s = small.back(); small.pop_back();
+		std::size_t l = large.back(); large.pop_back();
+
+		_probability[s] = scaled[s];
+		_alias[s]       = l;
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		( scaled[l] < 1.0 ? small : large ).push_back(l);
+	}
+
+	// what is left is one (up to rounding)
+	for (const auto& i : large){ _probability[i] = 1.0; _alias[i] = i; }
+	for (const auto& i : small){ _probability[i] = 1.0; _alias[i] = i; }
+}
+
+std::size_t AliasTable::Pick(const double u1, const double u2) const {
+
+	std::size_t i = std::min(_alias.size() - 1,
+		(std::size_t) (u1 * _alias.size()));
+
+	return u2 < _probability[i] ? i : _alias[i];
+}
+
+QuasiRandom::QuasiRandom(const Sequence sequence, const int threads,
+	const unsigned long long seed){
+
+	_sequence = sequence;
+	_seed     = seed;
+	_next.resize(threads);
+
+	//
+	// Direction numbers for the first three dimensions (Joe and Kuo): the
+	// first is the van der Corput sequence, then the primitive polynomials
+	// x + 1 (m = 1) and x^2 + x + 1 (m = 1, 3).
+	//
+
+	const int degree[3]     = { 0, 1, 2 };
+	const int polynomial[3] = { 0, 0, 1 };
+	const std::uint64_t initial[3][2] = { {1, 1}, {1, 1}, {1, 3} };
+
+	for (int d = 0; d < 3; d++)
+	for (int k = 0; k < 64; k++){
+
+		int s = degree[d];
+
+		if ( !s ){ _direction[d][k] = 1ULL << (63 - k); continue; }
+		if ( k < s ){ _direction[d][k] = initial[d][k] << (63 - k); continue; }
+
+		std::uint64_t v = _direction[d][k - s] ^ (_direction[d][k - s] >> s);
+		for (int j = 1; j < s; j++)
+			if ( (polynomial[d] >> (s - 1 - j)) & 1 ) v ^= _direction[d][k - j];
+
+		_direction[d][k] = v;
+	}
+
+	// digits of the index that still matter in double precision
+	const int base[3] = { 2, 3, 5 };
+	for (int d = 0; d < 3; d++)
+		_digits[d] = (int) std::ceil(53.0 * std::log(2.0) / std::log(base[d]));
+
+	Restart(0);
+}
+
+void QuasiRandom::Restart(const unsigned long long epoch){
+
+	_epoch = epoch;
+
+	for (std::size_t i = 0; i < _next.size(); i++)
+		_next[i] = (std::uint64_t) i << QMC_BLOCK_BITS;
+
+	// the scrambling only depends on the seed and the epoch
+	MT19937 source(_seed ^ (0xD1B54A32D192ED03ULL * (epoch + 1)));
+
+	const int base[3] = { 2, 3, 5 };
+	for (int d = 0; d < 3; d++){
+
+		_shift[d] = source.RandomInteger();
+
+		// Fisher-Yates shuffle of the digits
+		_permutation[d].resize(base[d]);
+		for (int k = 0; k < base[d]; k++)
+			_permutation[d][k] = k;
+
+		for (int k = base[d] - 1; k > 0; k--)
+			std::swap(_permutation[d][k],
+				_permutation[d][ source.RandomInteger() % (k + 1) ]);
+	}
+}
+
+void QuasiRandom::Next(const int thread, double point[3]){
+
+	if ( thread < 0 || thread >= (int) _next.size() ) throw IndexError("From "
+		"QuasiRandom::Next(), you requested a stream by thread number that "
+		"was out of bounds!");
+
+	Point(_next[thread]++, point);
+}
+
+void QuasiRandom::Point(const std::uint64_t index, double point[3]) const {
+
+	if ( _sequence == SOBOL ){
+
+		// in Gray code order each point differs by one direction number
+		std::uint64_t gray = index ^ (index >> 1);
+
+		for (int d = 0; d < 3; d++){
+
+			std::uint64_t x = _shift[d];
+			for (std::uint64_t g = gray; g; g &= g - 1)
+				x ^= _direction[d][ __builtin_ctzll(g) ];
+
+			point[d] = (x >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		return;
+	}
+
+	// radical inverse, the trailing zeros are permuted too
+	const int base[3] = { 2, 3, 5 };
+	for (int d = 0; d < 3; d++){
+
+		std::uint64_t n = index;
+		double scale = 1.0 / base[d], u = 0.0;
+
+		for (int k = 0; k < _digits[d]; k++, scale /= base[d]){
+
+			u += _permutation[d][ n % base[d] ] * scale;
+			n /= base[d];
+		}
+
+		// the sum may round up to one
+		point[d] = std::min(u, 1.0 - 1.0 / 9007199254740992.0);
+	}
+}
+
+std::vector<unsigned long long> QuasiRandom::GetState() const {
+
+	std::vector<unsigned long long> state(1, _epoch);
+	state.insert(state.end(), _next.begin(), _next.end());
+
+	return state;
+}
+
+void QuasiRandom::SetState(const std::vector<unsigned long long> &state){
+
+	if ( state.size() != _next.size() + 1 ) throw IndexError("From "
+		"QuasiRandom::SetState(), the state doesn't match the number of "
+		"streams!");
+
+	Restart(state[0]);
+	std::copy(state.begin() + 1, state.end(), _next.begin());
+}
+
 } // namespace Gaia
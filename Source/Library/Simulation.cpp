@@ -10,6 +10,8 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <algorithm>
+#include <omp.h>
 
 #include <Simulation.hpp>
 #include <FileManager.hpp>
@@ -53,12 +55,13 @@ Simulation::Simulation(const int argc, const char *argv[]){
 
 Simulation::~Simulation(){
 
+	// release file manager first, the writes it still has queued read the
+	// parser (for the headers of binary and FITS files)
+	FileManager::Release();
+
 	// release the parser
 	Parser::Release();
 
-	// release file manager
-	FileManager::Release();
-
 	// release the display monitor
 	Monitor::Release();
 
@@ -79,16 +82,62 @@ void Simulation::Run(){
 
 	// greet the user
 	if (verbose) std::cout
-        << "\n Building " << trials
+        << "\n Building " << ( parser -> GetAutoTrialsFlag() ? "up to " : "" )
+        << trials
         << " population(s) of size " << N << " ...\n";
 
+	// with `--resume` the trials already completed are skipped
+	int start = population -> Resume();
+
+	// whole trials run concurrently (progress is shown as they finish)
+	bool concurrent = population -> TrialParallel();
+	if (concurrent) population -> RunTrials(start);
+
+	// build trial t + 1 while trial t is analyzed
+	bool pipeline = parser -> GetPipelineFlag() && population -> CanPipeline()
+		&& trials > start + 1 && !concurrent && !population -> Converged();
+
+	// threads for each stage of the pipeline
+	int threads          = parser -> GetNumThreads();
+	int build_threads    = parser -> GetBuildThreads();
+	int analysis_threads = std::max(1, threads - build_threads);
+
+	// the first population has all threads to itself
+	if (pipeline) population -> Build(start);
+
 	// iterate over all trials
-	for (int t = 0; t < trials; t++){
+	for (int t = start; t < trials && !concurrent && !population -> Converged();
+		t++){
 
 		// display progress bar
 		if (verbose == 2)
 		display -> Progress(t, trials);
 
+		if (pipeline){
+
+			// the next population is drawn while this one is analyzed
+			if (t + 1 < trials)
+				population -> BuildAhead(t + 1, build_threads);
+
+			omp_set_num_threads(analysis_threads);
+
+			if (analysis){
+
+				population -> FindNeighbors(t);
+				population -> ProfileFit(t);
+			}
+
+			omp_set_num_threads(threads);
+
+			population -> SaveProgress(t + 1);
+
+			// wait for it (and save its positions)
+			if (t + 1 < trials)
+				population -> Advance(t + 1);
+
+			continue;
+		}
+
 		// build a new population
 		population -> Build(t);
 
@@ -100,6 +149,9 @@ void Simulation::Run(){
 			// fit a profile to curve
 			population -> ProfileFit(t);
 		}
+
+		// save the state every `--checkpoint-every` trials
+		population -> SaveProgress(t + 1);
 	}
 
 	// complete progress bar
@@ -108,6 +160,12 @@ void Simulation::Run(){
 	// combine statistics for nearest neighbor analysis
 	if (analysis) population -> Analysis();
 
+	// wait for the writer thread to finish (raises any write error)
+	file -> Drain();
+
+	// write the archive's index
+	file -> Close();
+
 	if (verbose) display -> TotalElapsedTime();
 }
 
@@ -162,6 +220,8 @@ void Simulation::Debug(){
     " -----------------------------------------------------------\n"
     "\n Number of Particles    = " << parser -> GetNumParticles() <<
     "\n Number of Trials       = " << parser -> GetNumTrials()    <<
+        ( parser -> GetAutoTrialsFlag() ? " (at most, --tolerance " +
+        std::to_string(parser -> GetTolerance()) + ")" : "" ) <<
     "\n Number of Threads      = " << parser -> GetNumThreads()   <<
     "\n Verbosity              = " << parser -> GetVerbosity()    <<
     "\n Keep Positions         = " << keep_pos <<
@@ -177,14 +237,54 @@ void Simulation::Debug(){
     "\n Output file pattern    = " << parser -> GetOutPath() << "*.dat" <<
     "\n Raw file pattern       = " << parser -> GetRawPath() << "*.dat" <<
     "\n Position file pattern  = " << parser -> GetPosPath() << "*.dat" <<
+    "\n Output format          = " << parser -> GetFormat() <<
+    "\n Asynchronous output    = " << ( parser -> GetAsyncFlag() ? "true" :
+        "false" ) <<
+    "\n Archive                = " << ( parser -> GetArchiveFlag() ?
+        parser -> GetArchivePath() : "off" ) <<
+    "\n Pipelined trials       = " << ( parser -> GetPipelineFlag() ?
+        std::to_string(parser -> GetBuildThreads()) + " build thread(s)" :
+        std::string("false") ) <<
+    "\n Parallelism            = " << ( population -> TrialParallel() ?
+        "trials" : "particles" ) << " (--parallel=" <<
+        parser -> GetParallelMode() << ")" <<
+    "\n Proposals              = " << parser -> GetProposals() <<
+        ( parser -> GetRestartFlag() ? " (restarted every trial)" : "" ) <<
+        ( parser -> GetSamplerFlag() && parser -> GetProposals() == "mt" ?
+        ", from a sampler if possible" : "" ) <<
+        ( parser -> GetEnvelopeFlag() ? " or an (R, Z) table" : "" ) <<
+    "\n Profile order          = " << ( parser -> GetReorderFlag() ?
+        "by cost and selectivity" : "as given" ) <<
+    "\n 2D tables              = " << ( parser -> GetInterpolation() ==
+        "cubic" ? "bicubic" : "bilinear" ) <<
+    "\n Compiled chain         = " << ( population -> GetChain() ?
+        population -> GetChain() -> Describe() : "none" ) <<
+    "\n Checkpoint             = " << ( parser -> GetCheckpointFlag() ?
+        parser -> GetCheckpointPath() + " (every " +
+        std::to_string(parser -> GetCheckpointEvery()) + ")" : "none" ) <<
+        ( parser -> GetResumeFlag() ? ", resuming" : "" ) <<
+    "\n Voxel cache            = " << ( !parser -> GetVoxelFlag() ? "off" :
+        std::to_string(parser -> GetVoxelResolution()) + "^3, tolerance " +
+        std::to_string(parser -> GetVoxelTolerance()) + ( parser ->
+        GetVoxelPath().empty() ? "" : ", " + parser -> GetVoxelPath() ) ) <<
+    "\n Memory budget (MB)     = " << ( parser -> GetMaxMemory() ?
+        std::to_string(parser -> GetMaxMemory() / 1024 / 1024) : "none" ) <<
     "\n RC file used           = " << parser -> GetRCFile() <<
+    "\n Profile cache          = " << ( !parser -> GetCacheFlag() ? "off" :
+        parser -> GetCachePath().empty() ? "next to data" :
+        parser -> GetCachePath() ) <<
     "\n" <<
     "\n Used PDFs:" <<
     "\n\n";
 
+    std::map<std::string, std::string> defined = parser -> GetDefinedPDFs();
+
     for ( const auto& pdf : parser -> GetUsedPDFs() ){
 
-        std::string pdftype = pdf.second.empty() ? "(Analytical)" :
+        std::string pdftype = defined.count(pdf.first) ? "(defined as \"" +
+            defined[pdf.first] + "\")" : !pdf.first.compare(0, 7, "plugin:") ?
+            "(Plugin" + ( pdf.second.empty() ? "" : ", given \"" + pdf.second +
+            "\"" ) + ")" : pdf.second.empty() ? "(Analytical)" :
             "(from file `" + pdf.second + "`)";
 
         std::cout << "\t * " << pdf.first << ", " << pdftype << std::endl;
@@ -0,0 +1,437 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/TextWriter.cc
+//
+// Source file for the `TextWriter` class. The number formatting follows the
+// Grisu2 algorithm from F. Loitsch, "Printing Floating-Point Numbers Quickly
+// and Accurately with Integers", PLDI 2010. The output always parses back to
+// the same double and is the shortest such string in all but a tiny fraction
+// of cases. The table of cached powers of ten is computed exactly (with
+// arbitrary precision integers) the first time it is needed.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <TextWriter.hpp>
+
+namespace Gaia {
+
+namespace {
+
+// `do it yourself` floating point number, f * 2^e
+struct DiyFp {
+
+	std::uint64_t f;
+	int e;
+
+	DiyFp(std::uint64_t f_ = 0, int e_ = 0): f(f_), e(e_){ }
+};
+
+// x - y, for x.e == y.e and x.f >= y.f
+DiyFp Sub(const DiyFp &x, const DiyFp &y){ return DiyFp(x.f - y.f, x.e); }
+
+// x * y rounded to 64 bits
+DiyFp Mul(const DiyFp &x, const DiyFp &y){
+
+	std::uint64_t a = x.f >> 32, b = x.f & 0xFFFFFFFFu;
+	std::uint64_t c = y.f >> 32, d = y.f & 0xFFFFFFFFu;
+
+	std::uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	std::uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFFu) + (bc & 0xFFFFFFFFu);
+
+	mid += 1u << 31; // round
+
+	return DiyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+DiyFp Normalize(DiyFp x){
+
+	while ( !(x.f >> 63) ) { x.f <<= 1; x.e--; }
+	return x;
+}
+
+DiyFp NormalizeTo(const DiyFp &x, const int e){
+
+	return DiyFp(x.f << (x.e - e), e);
+}
+
+// cached power of ten, 10^k ~ f * 2^e
+struct CachedPower {
+
+	std::uint64_t f;
+	int e, k;
+};
+
+// the cached powers span 10^-300 through 10^324 in steps of 10^8
+const int MinDecExp = -300;
+const int DecStep   =  8;
+const int NumPowers =  79;
+
+// target range for the binary exponent of the scaled number
+const int Alpha = -60;
+const int Gamma = -32;
+
+// little-endian arbitrary precision integer (only what the table needs)
+typedef std::vector<std::uint32_t> BigInt;
+
+void MulSmall(BigInt &x, std::uint32_t m){
+
+	std::uint64_t carry = 0;
+
+	for ( auto& word : x ){
+
+		carry += std::uint64_t(word) * m;
+		word   = carry & 0xFFFFFFFFu;
+		carry >>= 32;
+	}
+
+	if ( carry ) x.push_back(carry);
+}
+
+int BitLength(const BigInt &x){
+
+	int n = 32 * (x.size() - 1);
+	for ( std::uint32_t top = x.back(); top; top >>= 1 ) n++;
+	return n;
+}
+
+bool Bit(const BigInt &x, const int i){
+
+	return i >= 0 && (x[i / 32] >> (i % 32)) & 1u;
+}
+
+bool LessEqual(const BigInt &x, const BigInt &y){
+
+	for ( std::size_t i = x.size(); i-- > 0; )
+		if ( x[i] != y[i] ) return x[i] < y[i];
+
+	return true;
+}
+
+void Subtract(BigInt &x, const BigInt &y){
+
+	std::int64_t borrow = 0;
+
+	for ( std::size_t i = 0; i < x.size(); i++ ){
+
+		std::int64_t d = std::int64_t(x[i]) - y[i] - borrow;
+		borrow = d < 0;
+		x[i]   = d + (borrow << 32);
+	}
+}
+
+// exact 10^k, rounded to a normalized 64 bit significand
+CachedPower Power(const int k){
+
+	BigInt ten(1, 1);
+	for ( int i = 0; i < (k < 0 ? -k : k); i++ )
+		MulSmall(ten, 10);
+
+	int L = BitLength(ten);
+	CachedPower power;
+	power.k = k;
+
+	if ( k >= 0 ) {
+
+		// top 64 bits and the next bit for rounding
+		std::uint64_t f = 0;
+		for ( int i = 0; i < 64; i++ )
+			f = (f << 1) | Bit(ten, L - 1 - i);
+
+		power.e = L - 64;
+
+		if ( Bit(ten, L - 65) ) {
+			if ( ++f == 0 ) { f = 1ULL << 63; power.e++; }
+		}
+
+		power.f = f;
+
+	} else {
+
+		// 2^(63 + L) / 10^-k by long division, the quotient has 64 bits
+		BigInt remainder(ten.size() + 1, 0);
+		BigInt divisor = ten;
+		divisor.resize(remainder.size(), 0);
+		std::uint64_t q = 0;
+
+		for ( int i = 63 + L; i >= -1; i-- ){
+
+			// remainder = 2 * remainder + (bit i of 2^(63 + L)), the last
+			// pass (i = -1) only decides the rounding
+			std::uint32_t carry = i == 63 + L;
+			for ( auto& word : remainder ){
+
+				std::uint32_t next = word >> 31;
+				word  = (word << 1) | carry;
+				carry = next;
+			}
+
+			bool fits = LessEqual(divisor, remainder);
+
+			if ( i < 0 ) {
+				if ( fits ) q++;
+				break;
+			}
+
+			q <<= 1;
+			if ( fits ){
+				Subtract(remainder, divisor);
+				q |= 1;
+			}
+		}
+
+		power.e = -(63 + L);
+		if ( q == 0 ) { q = 1ULL << 63; power.e++; }
+		power.f = q;
+	}
+
+	return power;
+}
+
+const std::vector<CachedPower>& Powers(){
+
+	static const std::vector<CachedPower> table = []{
+
+		std::vector<CachedPower> powers;
+		for ( int i = 0; i < NumPowers; i++ )
+			powers.push_back( Power(MinDecExp + i * DecStep) );
+
+		return powers;
+	}();
+
+	return table;
+}
+
+// a power of ten such that the product with 2^e has a binary exponent
+// between `Alpha` and `Gamma`
+CachedPower CachedPowerFor(const int e){
+
+	int f = Alpha - e - 1;
+	int k = (f * 78913) / (1 << 18) + (f > 0);
+	int index = (-MinDecExp + k + (DecStep - 1)) / DecStep;
+
+	return Powers()[index];
+}
+
+// largest power of ten <= n, returns its exponent + 1
+int LargestPow10(const std::uint32_t n, std::uint32_t &pow10){
+
+	const std::uint32_t p[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000,
+		10000000, 100000000, 1000000000 };
+
+	for ( int k = 9; k > 0; k-- )
+		if ( n >= p[k] ) { pow10 = p[k]; return k + 1; }
+
+	pow10 = 1;
+	return 1;
+}
+
+void Round(char *buffer, int length, std::uint64_t dist, std::uint64_t delta,
+	std::uint64_t rest, std::uint64_t ten_k){
+
+	// move the last digit towards `w` while it stays inside the interval
+	while ( rest < dist && delta - rest >= ten_k &&
+		( rest + ten_k < dist || dist - rest > rest + ten_k - dist ) ){
+
+		buffer[length - 1]--;
+		rest += ten_k;
+	}
+}
+
+// generate the digits of `w` within (M_minus, M_plus)
+void DigitGen(char *buffer, int &length, int &exponent, const DiyFp &M_minus,
+	const DiyFp &w, const DiyFp &M_plus){
+
+	std::uint64_t delta = Sub(M_plus, M_minus).f;
+	std::uint64_t dist  = Sub(M_plus, w).f;
+
+	const DiyFp one(std::uint64_t(1) << -M_plus.e, M_plus.e);
+
+	std::uint32_t p1 = M_plus.f >> -one.e;
+	std::uint64_t p2 = M_plus.f & (one.f - 1);
+
+	// integral digits
+	std::uint32_t pow10;
+	int n = LargestPow10(p1, pow10);
+
+	while ( n > 0 ){
+
+		std::uint32_t d = p1 / pow10;
+		p1 %= pow10;
+		buffer[length++] = '0' + d;
+		n--;
+
+		std::uint64_t rest = (std::uint64_t(p1) << -one.e) + p2;
+
+		if ( rest <= delta ){
+
+			exponent += n;
+			Round(buffer, length, dist, delta, rest,
+				std::uint64_t(pow10) << -one.e);
+			return;
+		}
+
+		pow10 /= 10;
+	}
+
+	// fractional digits
+	int m = 0;
+
+	while ( true ){
+
+		p2    *= 10;
+		delta *= 10;
+		dist  *= 10;
+
+		buffer[length++] = '0' + (p2 >> -one.e);
+		p2 &= one.f - 1;
+		m++;
+
+		if ( p2 <= delta ) break;
+	}
+
+	exponent -= m;
+	Round(buffer, length, dist, delta, p2, one.f);
+}
+
+// shortest digits and decimal exponent of a finite, positive double
+void Grisu2(char *buffer, int &length, int &exponent, const double value){
+
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const std::uint64_t hidden = std::uint64_t(1) << 52;
+	const int bias = 1075;
+
+	std::uint64_t F = bits & (hidden - 1);
+	int E = bits >> 52;
+
+	DiyFp v = E ? DiyFp(F + hidden, E - bias) : DiyFp(F, 1 - bias);
+
+	// the boundaries m- and m+ halfway to the neighboring doubles
+	bool closer = F == 0 && E > 1;
+	DiyFp m_plus(2 * v.f + 1, v.e - 1);
+	DiyFp m_minus = closer ? DiyFp(4 * v.f - 1, v.e - 2) :
+		DiyFp(2 * v.f - 1, v.e - 1);
+
+	DiyFp w_plus  = Normalize(m_plus);
+	DiyFp w_minus = NormalizeTo(m_minus, w_plus.e);
+	DiyFp w       = Normalize(v);
+
+	// scale into the target range
+	CachedPower cached = CachedPowerFor(w_plus.e);
+	DiyFp c(cached.f, cached.e);
+
+	DiyFp W       = Mul(w, c);
+	DiyFp W_minus = Mul(w_minus, c);
+	DiyFp W_plus  = Mul(w_plus, c);
+
+	// shrink the interval by one unit on each side to stay safe
+	DiyFp M_minus(W_minus.f + 1, W_minus.e);
+	DiyFp M_plus (W_plus.f  - 1, W_plus.e );
+
+	length   = 0;
+	exponent = -cached.k;
+	DigitGen(buffer, length, exponent, M_minus, W, M_plus);
+}
+
+// write digits with decimal exponent `exponent` in plain or scientific form
+char* Layout(char *buffer, const char *digits, const int k, const int exponent){
+
+	// position of the decimal point relative to the digits
+	int n = k + exponent;
+
+	if ( k <= n && n <= 16 ){
+
+		// 1234e5 -> 123400000
+		std::memcpy(buffer, digits, k);
+		std::memset(buffer + k, '0', n - k);
+		return buffer + n;
+	}
+
+	if ( 0 < n && n <= 16 ){
+
+		// 1234e-2 -> 12.34
+		std::memcpy(buffer, digits, n);
+		buffer[n] = '.';
+		std::memcpy(buffer + n + 1, digits + n, k - n);
+		return buffer + k + 1;
+	}
+
+	if ( -5 < n && n <= 0 ){
+
+		// 1234e-6 -> 0.001234
+		buffer[0] = '0';
+		buffer[1] = '.';
+		std::memset(buffer + 2, '0', -n);
+		std::memcpy(buffer + 2 - n, digits, k);
+		return buffer + 2 - n + k;
+	}
+
+	// scientific, d.ddde+XX
+	*buffer++ = digits[0];
+
+	if ( k > 1 ){
+		*buffer++ = '.';
+		std::memcpy(buffer, digits + 1, k - 1);
+		buffer += k - 1;
+	}
+
+	int e = n - 1;
+	*buffer++ = 'e';
+	*buffer++ = e < 0 ? '-' : '+';
+	if ( e < 0 ) e = -e;
+
+	if ( e >= 100 ) { *buffer++ = '0' + e / 100; e %= 100; }
+	*buffer++ = '0' + e / 10;
+	*buffer++ = '0' + e % 10;
+
+	return buffer;
+}
+
+} // anonymous namespace
+
+char* TextWriter::Format(double value, char *buffer){
+
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	if ( bits >> 63 ) {
+		*buffer++ = '-';
+		value = -value;
+		bits &= ~(std::uint64_t(1) << 63);
+	}
+
+	if ( bits == 0 ) { *buffer++ = '0'; return buffer; }
+
+	if ( (bits >> 52) == 0x7FF ){
+
+		const char *special = (bits & ((std::uint64_t(1) << 52) - 1)) ?
+			"nan" : "inf";
+		std::memcpy(buffer, special, 3);
+		return buffer + 3;
+	}
+
+	char digits[20];
+	int length, exponent;
+	Grisu2(digits, length, exponent, value);
+
+	return Layout(buffer, digits, length, exponent);
+}
+
+std::string TextWriter::Format(double value){
+
+	char buffer[32];
+	return std::string(buffer, Format(value, buffer));
+}
+
+void TextWriter::Write(const std::string &filename,
+	const std::vector<const double*> &columns, const std::size_t rows){
+
+	Write(filename, rows, columns.size(),
+		[&columns](std::size_t i, std::size_t j){ return columns[j][i]; });
+}
+
+} // namespace Gaia
@@ -0,0 +1,281 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Library/VoxelCache.cc
+//
+// Source file for the `VoxelCache` class. See Include/VoxelCache.hpp.
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <omp.h>
+
+#include <VoxelCache.hpp>
+#include <Checkpoint.hpp>
+#include <Exception.hpp>
+
+#define VOXEL_MAGIC   "GAIAVOX"
+#define VOXEL_VERSION 1
+
+namespace Gaia {
+
+static_assert(sizeof(VoxelCache::Header) == 64,
+	"VoxelCache::Header must be exactly 64 bytes!");
+
+VoxelCache::VoxelCache(const std::vector<ProfileBase*> &profiles,
+	const std::vector<double> &X, const std::vector<double> &Y,
+	const std::vector<double> &Z, const std::size_t resolution,
+	const double tolerance, const std::string &key, const std::string &path,
+	const ChainBase *chain){
+
+	_profiles = profiles;
+	_chain    = chain;
+	_alias    = nullptr;
+	_loaded   = false;
+
+	const std::vector<double> *limits[3] = { &X, &Y, &Z };
+	for ( int d = 0; d < 3; d++ ){
+
+		_origin[d] = (*limits[d])[0];
+		_span[d]   = (*limits[d])[1] - (*limits[d])[0];
+	}
+
+	// the image is only valid for exactly this configuration
+	std::stringstream configuration;
+	configuration.precision(17);
+	configuration << key << ' ' << resolution << ' ' << tolerance;
+	for ( int d = 0; d < 3; d++ )
+		configuration << ' ' << _origin[d] << ' ' << _span[d];
+
+	_key = Checkpoint::Signature( configuration.str() );
+
+	if ( !path.empty() && Load(path) ) _loaded = true;
+
+	else {
+
+		std::size_t n = std::max<std::size_t>(1, resolution);
+		Fill(n);
+		_error = Estimate();
+
+		// double the resolution until the error is within the budget
+		while ( _error > tolerance && 8 * n * n * n <= VOXEL_MAX_CELLS ){
+
+			n *= 2;
+			Fill(n);
+			_error = Estimate();
+		}
+
+		if ( !path.empty() ) Save(path);
+	}
+
+	Bounds();
+}
+
+VoxelCache::~VoxelCache(){
+
+	if ( _alias ) delete _alias;
+}
+
+double VoxelCache::Product(const Vector &position) const {
+
+	Point point(position);
+	if ( _chain ) return _chain -> Product(point);
+
+	double product = 1.0;
+
+	for ( const auto& pdf : _profiles )
+		product *= ProfileBase::Keep( pdf -> Evaluate(point) );
+
+	return product;
+}
+
+void VoxelCache::Fill(const std::size_t n){
+
+	_n = n;
+	for ( int d = 0; d < 3; d++ )
+		_width[d] = _span[d] / n;
+
+	std::size_t side = n + 1;
+	_nodes.resize(side * side * side);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for ( std::size_t i = 0; i < side; i++ ){
+
+		std::vector<Vector> row(side);
+
+		for ( std::size_t j = 0; j < side; j++ ){
+
+			for ( std::size_t k = 0; k < side; k++ )
+				row[k] = Vector(_origin[0] + i * _width[0],
+					_origin[1] + j * _width[1], _origin[2] + k * _width[2]);
+
+			// a compiled chain takes the whole row at once
+			double *nodes = &_nodes[(i * side + j) * side];
+			if ( _chain ) _chain -> Product(row.data(), side, nodes);
+			else for ( std::size_t k = 0; k < side; k++ )
+				nodes[k] = Product(row[k]);
+		}
+	}
+}
+
+double VoxelCache::Estimate() const {
+
+	//
+	// The interpolation is furthest from the nodes at the centers of the
+	// voxels, the largest difference there relative to the largest value
+	// is the error of the grid.
+	//
+
+	double scale = 0.0, error = 0.0;
+
+	for ( const auto& value : _nodes )
+		scale = std::max(scale, std::abs(value));
+
+	#pragma omp parallel for schedule(dynamic, 1) reduction(max: error)
+	for ( std::size_t i = 0; i < _n; i++ )
+	for ( std::size_t j = 0; j < _n; j++ )
+	for ( std::size_t k = 0; k < _n; k++ ){
+
+		Vector center(_origin[0] + (i + 0.5) * _width[0],
+			_origin[1] + (j + 0.5) * _width[1],
+			_origin[2] + (k + 0.5) * _width[2]);
+
+		error = std::max(error, std::abs(Evaluate(center) - Product(center)));
+	}
+
+	return scale > 0.0 ? error / scale : 0.0;
+}
+
+void VoxelCache::Bounds(){
+
+	std::size_t side = _n + 1;
+	_bound.resize(_n * _n * _n);
+
+	for ( std::size_t i = 0; i < _n; i++ )
+	for ( std::size_t j = 0; j < _n; j++ )
+	for ( std::size_t k = 0; k < _n; k++ ){
+
+		// the interpolation never exceeds the largest corner
+		double largest = 0.0;
+
+		for ( int c = 0; c < 8; c++ )
+			largest = std::max(largest, _nodes[((i + (c >> 2)) * side +
+				j + ((c >> 1) & 1)) * side + k + (c & 1)]);
+
+		_bound[(i * _n + j) * _n + k] = largest;
+	}
+
+	if ( *std::max_element(_bound.begin(), _bound.end()) <= 0.0 )
+		throw ProfileError("From VoxelCache::Bounds(), the profiles vanish "
+		"everywhere in the `box`!");
+
+	_alias = new AliasTable(_bound);
+}
+
+double VoxelCache::Evaluate(const Vector &position) const {
+
+	const double point[3] = { position.X(), position.Y(), position.Z() };
+	std::size_t cell[3];
+	double f[3];
+
+	for ( int d = 0; d < 3; d++ ){
+
+		double t = std::min(double(_n), std::max(0.0,
+			(point[d] - _origin[d]) / _width[d]));
+
+		cell[d] = std::min(_n - 1, std::size_t(t));
+		f[d]    = t - cell[d];
+	}
+
+	std::size_t side = _n + 1;
+	double value = 0.0;
+
+	for ( int c = 0; c < 8; c++ ){
+
+		int a = c >> 2, b = (c >> 1) & 1, e = c & 1;
+
+		value += (a ? f[0] : 1.0 - f[0]) * (b ? f[1] : 1.0 - f[1]) *
+			(e ? f[2] : 1.0 - f[2]) * _nodes[((cell[0] + a) * side +
+			cell[1] + b) * side + cell[2] + e];
+	}
+
+	return value;
+}
+
+Vector VoxelCache::Sample(ParallelMT *source, const int thread,
+	double &bound) const {
+
+	std::size_t voxel = _alias -> Pick(source -> RandomReal(thread),
+		source -> RandomReal(thread));
+
+	bound = _bound[voxel];
+
+	std::size_t i = voxel / _n / _n, j = voxel / _n % _n, k = voxel % _n;
+
+	return Vector(
+		_origin[0] + (i + source -> RandomReal(thread)) * _width[0],
+		_origin[1] + (j + source -> RandomReal(thread)) * _width[1],
+		_origin[2] + (k + source -> RandomReal(thread)) * _width[2]);
+}
+
+bool VoxelCache::Load(const std::string &path){
+
+	FILE *input = std::fopen(path.c_str(), "rb");
+	if ( !input ) return false;
+
+	Header header;
+	bool good = std::fread(&header, sizeof(Header), 1, input) == 1 &&
+		!std::strncmp(header.magic, VOXEL_MAGIC, sizeof(header.magic)) &&
+		header.version == VOXEL_VERSION && header.byte_order == 0x01020304 &&
+		header.key == _key && header.n > 0 && header.n * header.n * header.n
+		<= VOXEL_MAX_CELLS;
+
+	if ( good ){
+
+		_n = header.n;
+		_error = header.error;
+
+		for ( int d = 0; d < 3; d++ )
+			_width[d] = _span[d] / _n;
+
+		_nodes.resize((_n + 1) * (_n + 1) * (_n + 1));
+		good = std::fread(_nodes.data(), sizeof(double), _nodes.size(), input)
+			== _nodes.size();
+	}
+
+	std::fclose(input);
+	return good;
+}
+
+void VoxelCache::Save(const std::string &path) const {
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	std::strncpy(header.magic, VOXEL_MAGIC, sizeof(header.magic));
+	header.version    = VOXEL_VERSION;
+	header.byte_order = 0x01020304;
+	header.key        = _key;
+	header.n          = _n;
+	header.error      = _error;
+
+	std::stringstream temp;
+	temp << path << ".tmp" << getpid();
+
+	// a failure only means the grid is computed again next time
+	FILE *output = std::fopen(temp.str().c_str(), "wb");
+	if ( !output ) return;
+
+	bool good = std::fwrite(&header, sizeof(Header), 1, output) == 1 &&
+		std::fwrite(_nodes.data(), sizeof(double), _nodes.size(), output) ==
+		_nodes.size();
+	good = !std::fclose(output) && good;
+
+	if ( !good || std::rename(temp.str().c_str(), path.c_str()) )
+		std::remove(temp.str().c_str());
+}
+
+} // namespace Gaia
@@ -0,0 +1,90 @@
+// Copyright (c) Geoffrey Lentner 2015. All Rights Reserved.
+// GNU General Public License v3.0
+// Plugins/ExponentialDisk.cpp
+//
+// An example profile plugin (see Include/Plugin.hpp), a single exponential
+// disk exp(-|z| / z_d - R / r_d). Build it with `make plugins` and use it as
+//
+//     include plugin:Plugins/ExponentialDisk.so "0.3 2.6"
+//
+// where the (optional) argument gives the scale height and length in kpc.
+
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+
+#include <Plugin.hpp>
+
+namespace {
+
+struct Disk {
+	double z_d, r_d;
+};
+
+double Evaluate(void *state, double x, double y, double z){
+
+	const Disk *disk = static_cast<Disk*>(state);
+	return std::exp( -std::abs(z) / disk -> z_d -
+		std::sqrt(x*x + y*y) / disk -> r_d );
+}
+
+void Batch(void *state, const double *x, const double *y, const double *z,
+	size_t n, double *out){
+
+	const Disk *disk = static_cast<Disk*>(state);
+	const double a = 1.0 / disk -> z_d, b = 1.0 / disk -> r_d;
+
+	#pragma omp simd
+	for ( size_t i = 0; i < n; i++ )
+		out[i] = std::exp( -std::abs(z[i]) * a -
+			std::sqrt(x[i]*x[i] + y[i]*y[i]) * b );
+}
+
+// the density is largest at the origin
+double Bound(void *state){ return 1.0; }
+
+// R * exp(-R / r_d) in radius (a gamma distribution), uniform in angle and
+// exp(-|z| / z_d) in height
+void Sample(void *state, double (*uniform)(void*), void *source,
+	double *position){
+
+	const Disk *disk = static_cast<Disk*>(state);
+
+	double R   = -disk -> r_d * std::log( (1.0 - uniform(source)) *
+		(1.0 - uniform(source)) );
+	double phi = 2.0 * M_PI * uniform(source);
+	double z   = -disk -> z_d * std::log( 1.0 - uniform(source) );
+
+	position[0] = R * std::cos(phi);
+	position[1] = R * std::sin(phi);
+	position[2] = uniform(source) < 0.5 ? z : -z;
+}
+
+void Release(void *state){ delete static_cast<Disk*>(state); }
+
+} // anonymous namespace
+
+extern "C" int gaia_register(GaiaPlugin *plugin, const double *limits,
+	const char *argument, const char **message){
+
+	Disk disk = { 0.3, 2.6 };
+
+	if ( argument && *argument && ( std::sscanf(argument, "%lf %lf",
+		&disk.z_d, &disk.r_d) != 2 || disk.z_d <= 0.0 || disk.r_d <= 0.0 ) ){
+
+		*message = "expected a positive scale height and length";
+		return 1;
+	}
+
+	plugin -> version  = GAIA_PLUGIN_VERSION;
+	plugin -> name     = "ExponentialDisk";
+	plugin -> symmetry = GAIA_SYMMETRY_AXISYMMETRIC;
+	plugin -> state    = new Disk(disk);
+	plugin -> evaluate = Evaluate;
+	plugin -> batch    = Batch;
+	plugin -> bound    = Bound;
+	plugin -> sample   = Sample;
+	plugin -> release  = Release;
+
+	return 0;
+}